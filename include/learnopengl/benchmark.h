@@ -0,0 +1,172 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+#include <learnopengl/gl_counters.h>
+#include <learnopengl/profiler.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// one point of the scripted camera path, time in seconds
+struct CameraKey {
+    float time;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+// Scripted, reproducible run for
+// `project_base --benchmark [--frames N] [--delta seconds] [--csv file] [--scene file] [--instance-scale k]
+// [--deferred]`.
+// Every frame advances by the fixed delta, the camera follows a looping path around the cars, and the CPU time,
+// GPU time and GL call counts of every frame end up in a CSV file with a summary printed at the end.
+class Benchmark
+{
+public:
+    bool enabled = false;
+    unsigned int frames = 600;
+    float deltaTime = 1.0f / 60.0f;
+    std::string csvPath = "benchmark.csv";
+    // the scene file is also taken without --benchmark
+    std::string scenePath = "resources/scenes/default.scene";
+    // overrides instance_scale of the scene file when set
+    float instanceScale = 0.0f;
+    // starts on the deferred shading path instead of the forward one
+    bool deferred = false;
+    unsigned int frame = 0;
+
+    static Benchmark FromArguments(int argc, char **argv)
+    {
+        Benchmark benchmark;
+        for (int i = 1; i < argc; i++)
+        {
+            bool hasValue = i + 1 < argc;
+            if (std::strcmp(argv[i], "--benchmark") == 0)
+                benchmark.enabled = true;
+            else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+                benchmark.frames = (unsigned int) std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(argv[i], "--delta") == 0 && hasValue)
+                benchmark.deltaTime = (float) std::atof(argv[++i]);
+            else if (std::strcmp(argv[i], "--csv") == 0 && hasValue)
+                benchmark.csvPath = argv[++i];
+            else if (std::strcmp(argv[i], "--scene") == 0 && hasValue)
+                benchmark.scenePath = argv[++i];
+            else if (std::strcmp(argv[i], "--instance-scale") == 0 && hasValue)
+                benchmark.instanceScale = (float) std::atof(argv[++i]);
+            else if (std::strcmp(argv[i], "--deferred") == 0)
+                benchmark.deferred = true;
+            else
+                std::cout << "Unknown argument: " << argv[i] << std::endl;
+        }
+        return benchmark;
+    }
+
+    bool Running() const
+    {
+        return frame < frames;
+    }
+
+    float Time() const
+    {
+        return frame * deltaTime;
+    }
+
+    // puts the camera where the path is at the current frame
+    void PlaceCamera(Camera &camera) const
+    {
+        static const CameraKey path[] = {
+                {0.0f,  glm::vec3(-34.0f, 12.8f, -0.6f), 3.0f,   -29.0f},
+                {3.0f,  glm::vec3(-20.0f, 4.0f, 9.0f),   -60.0f, -10.0f},
+                {6.0f,  glm::vec3(6.0f, 3.0f, -7.0f),    140.0f, -8.0f},
+                {8.0f,  glm::vec3(25.0f, 10.0f, 0.0f),   180.0f, -20.0f},
+                {10.0f, glm::vec3(-34.0f, 12.8f, -0.6f), 363.0f, -29.0f}
+        };
+        const unsigned int count = sizeof(path) / sizeof(path[0]);
+        float time = std::fmod(Time(), path[count - 1].time);
+        unsigned int key = 0;
+        while (key + 2 < count && path[key + 1].time <= time)
+            key++;
+        const CameraKey &from = path[key], &to = path[key + 1];
+        float t = (time - from.time) / (to.time - from.time);
+        camera.SetPose(glm::mix(from.position, to.position, t), from.yaw + (to.yaw - from.yaw) * t,
+                       from.pitch + (to.pitch - from.pitch) * t);
+    }
+
+    void BeginFrame()
+    {
+        GLCallCounter::Reset();
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    void EndFrame()
+    {
+        Sample sample;
+        sample.cpu = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        sample.calls = GLCallCounter::Counts();
+        samples.push_back(sample);
+        frame++;
+    }
+
+    // collects the GPU times from the profiler, writes the CSV and prints the summary
+    void Finish(Profiler &profiler)
+    {
+        profiler.Flush();
+        std::ofstream out(csvPath);
+        out << "frame,cpu_ms,gpu_ms,draw_calls,state_changes,uniform_uploads\n";
+        std::vector<float> cpu, gpu;
+        for (unsigned int i = 0; i < samples.size(); i++)
+        {
+            float gpuTime = i < profiler.frameTimes.size() ? profiler.frameTimes[i] : -1.0f;
+            out << i << ',' << samples[i].cpu << ',' << gpuTime << ',' << samples[i].calls.drawCalls << ','
+                << samples[i].calls.stateChanges << ',' << samples[i].calls.uniformUploads << '\n';
+            cpu.push_back(samples[i].cpu);
+            if (gpuTime >= 0.0f)
+                gpu.push_back(gpuTime);
+        }
+
+        std::cout << "Benchmark: " << samples.size() << " frames, per-frame data in " << csvPath << std::endl;
+        printSummary("CPU ms", cpu);
+        printSummary("GPU ms", gpu);
+        if (!samples.empty())
+        {
+            const GLCallCounts &last = samples.back().calls;
+            std::cout << "  last frame: " << last.drawCalls << " draw calls, " << last.stateChanges
+                      << " state changes, " << last.uniformUploads << " uniform uploads" << std::endl;
+        }
+    }
+
+private:
+    struct Sample {
+        float cpu;
+        GLCallCounts calls;
+    };
+
+    std::vector<Sample> samples;
+    std::chrono::steady_clock::time_point frameStart;
+
+    static void printSummary(const char *name, std::vector<float> values)
+    {
+        if (values.empty())
+        {
+            std::cout << "  " << name << ": no samples" << std::endl;
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        float sum = 0.0f;
+        for (float value : values)
+            sum += value;
+        std::cout << "  " << name << ": avg " << sum / values.size() << ", median " << values[values.size() / 2]
+                  << ", p95 " << values[values.size() * 95 / 100] << ", max " << values.back() << std::endl;
+    }
+};
+#endif
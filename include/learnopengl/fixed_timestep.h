@@ -0,0 +1,45 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <algorithm>
+
+// Accumulates the variable frame time and hands it out in steps of a fixed size, so the simulation advances the
+// same way no matter how long frames take. Whatever is left over is Alpha(), the fraction of a step the renderer
+// is ahead of the latest state, for blending the previous and the latest state.
+class FixedTimestep
+{
+public:
+    float step;
+    // upper bound of steps per frame, after a long stall the simulation slows down instead of never catching up
+    unsigned int maxSteps;
+
+    FixedTimestep(float step = 1.0f / 60.0f, unsigned int maxSteps = 8) : step(step), maxSteps(maxSteps)
+    {
+    }
+
+    // adds the time of a frame and returns how many steps to run for it
+    unsigned int Advance(float frameTime)
+    {
+        accumulator += std::max(frameTime, 0.0f);
+        unsigned int steps = 0;
+        while (accumulator >= step && steps < maxSteps)
+        {
+            accumulator -= step;
+            steps++;
+        }
+        // whatever could not be run is dropped
+        if (steps == maxSteps)
+            accumulator = std::min(accumulator, step);
+        return steps;
+    }
+
+    // how far between the previous and the latest state the frame is, in [0, 1]
+    float Alpha() const
+    {
+        return std::min(accumulator / step, 1.0f);
+    }
+
+private:
+    float accumulator = 0.0f;
+};
+#endif
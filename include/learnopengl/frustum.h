@@ -0,0 +1,136 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+// axis aligned box and the sphere around it, both in the space of the vertices they were built from
+struct BoundingVolume {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    bool empty = true;
+
+    void Extend(const glm::vec3 &point)
+    {
+        if (empty)
+        {
+            min = max = point;
+            empty = false;
+        }
+        else
+        {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+    }
+
+    void Extend(const BoundingVolume &other)
+    {
+        if (other.empty)
+            return;
+        Extend(other.min);
+        Extend(other.max);
+    }
+
+    // derives center and radius once the box is complete
+    void Finish()
+    {
+        center = (min + max) * 0.5f;
+        radius = glm::length(max - center);
+    }
+};
+
+// largest factor transform scales any axis by, what a bounding sphere's radius has to be multiplied with
+inline float TransformScale(const glm::mat4 &transform)
+{
+    return std::sqrt(std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                     std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                              glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])))));
+}
+
+// drawn and culled meshes of a frame; an instance of a model counts once per mesh
+struct CullStats {
+    // levels of detail counted, the coarser ones share the last entry
+    static const unsigned int LEVELS = 4;
+
+    unsigned int drawn = 0;
+    unsigned int culled = 0;
+    // beyond the fog, see LodSelector
+    unsigned int fogged = 0;
+    // drawn meshes per level of detail
+    unsigned int levels[LEVELS] = {};
+
+    void Drawn(int level, unsigned int meshes = 1)
+    {
+        drawn += meshes;
+        levels[std::min((unsigned int)level, LEVELS - 1)] += meshes;
+    }
+};
+
+// The six planes of a view-projection matrix (Gribb/Hartmann), normals pointing inwards. Bounds are tested
+// with the cheap sphere first and only the spheres that straddle a plane get the tighter box test.
+class Frustum
+{
+public:
+    Frustum()
+    {
+    }
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        glm::mat4 m = glm::transpose(viewProjection);
+        planes[0] = m[3] + m[0];
+        planes[1] = m[3] - m[0];
+        planes[2] = m[3] + m[1];
+        planes[3] = m[3] - m[1];
+        planes[4] = m[3] + m[2];
+        planes[5] = m[3] - m[2];
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    // is any part of the bounds, placed by transform, inside the frustum
+    bool Visible(const BoundingVolume &bounds, const glm::mat4 &transform) const
+    {
+        if (bounds.empty)
+            return false;
+        glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.center, 1.0f));
+        float radius = bounds.radius * TransformScale(transform);
+
+        bool straddles = false;
+        for (const glm::vec4 &plane : planes)
+        {
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            if (distance < -radius)
+                return false;
+            if (distance < radius)
+                straddles = true;
+        }
+        if (!straddles)
+            return true;
+
+        // world space box around the transformed box: the extent along every axis is |M| times the half size
+        glm::vec3 halfSize = (bounds.max - bounds.min) * 0.5f;
+        glm::mat3 linear = glm::mat3(transform);
+        glm::vec3 extent;
+        for (int axis = 0; axis < 3; axis++)
+            extent[axis] = std::fabs(linear[0][axis]) * halfSize.x + std::fabs(linear[1][axis]) * halfSize.y +
+                           std::fabs(linear[2][axis]) * halfSize.z;
+        for (const glm::vec4 &plane : planes)
+        {
+            glm::vec3 normal = glm::vec3(plane);
+            float reach = std::fabs(normal.x) * extent.x + std::fabs(normal.y) * extent.y + std::fabs(normal.z) * extent.z;
+            if (glm::dot(normal, center) + plane.w < -reach)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    glm::vec4 planes[6];
+};
+#endif
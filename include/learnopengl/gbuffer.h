@@ -0,0 +1,121 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <iostream>
+
+// Render targets of the deferred path: the geometry pass writes the surface attributes of the nearest fragment,
+// the lighting pass reads them back once per pixel. Albedo and specular colour are RGBA8, the normal RGBA16F and
+// positions come back from the depth texture, so nothing but what the lighting needs is stored.
+class GBuffer
+{
+public:
+    // texture units the lighting pass reads the targets from, in the order albedo, specular, normal, depth
+    static const unsigned int FIRST_UNIT = 0;
+
+    unsigned int FBO = 0;
+
+    GBuffer(unsigned int width, unsigned int height) : width(width), height(height)
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glGenTextures(4, textures);
+        allocate();
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            // one texel per pixel, never filtered
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, i < 3 ? GL_COLOR_ATTACHMENT0 + i : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                                   textures[i], 0);
+        }
+
+        unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+        glDrawBuffers(3, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "G-buffer not complete!" << std::endl;
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // points the samplers of the lighting program at the units BindTextures uses
+    static void Bind(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("gAlbedo", FIRST_UNIT);
+        shader.setInt("gSpecular", FIRST_UNIT + 1);
+        shader.setInt("gNormal", FIRST_UNIT + 2);
+        shader.setInt("gDepth", FIRST_UNIT + 3);
+    }
+
+    // makes the G-buffer the target of the geometry pass and clears it; blending is off while the targets are
+    // written, it would mix the attributes with the cleared ones by their alpha
+    void BeginGeometry() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glDisable(GL_BLEND);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // turns blending back on for the passes after the geometry pass
+    void EndGeometry() const
+    {
+        glEnable(GL_BLEND);
+    }
+
+    void BindTextures() const
+    {
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + FIRST_UNIT + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // reallocates the targets for a new framebuffer size
+    void Resize(unsigned int width, unsigned int height)
+    {
+        this->width = width;
+        this->height = height;
+        allocate();
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // GPU memory of all targets
+    size_t Bytes() const
+    {
+        return (size_t)width * height * (4 + 4 + 8 + 4);
+    }
+
+    void Release()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(4, textures);
+        FBO = 0;
+    }
+
+private:
+    unsigned int width, height;
+    unsigned int textures[4];
+
+    // storage of all targets at the current size
+    void allocate()
+    {
+        const GLenum formats[3] = {GL_RGBA8, GL_RGBA8, GL_RGBA16F};
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, GL_RGBA, i < 2 ? GL_UNSIGNED_BYTE : GL_FLOAT, NULL);
+        }
+        glBindTexture(GL_TEXTURE_2D, textures[3]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    }
+};
+#endif
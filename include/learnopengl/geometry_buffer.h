@@ -0,0 +1,227 @@
+#ifndef GEOMETRY_BUFFER_H
+#define GEOMETRY_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/vertex_format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+
+// where a mesh lives inside a GeometryBuffer, everything a draw needs besides the VAO
+struct GeometryRange {
+    int baseVertex = 0;
+    // byte offset of the first index in the index buffer
+    size_t indexOffset = 0;
+    unsigned int indexCount = 0;
+    // GL_UNSIGNED_SHORT for meshes of up to 65536 vertices, GL_UNSIGNED_INT otherwise
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // the offset as glDrawElements* wants it
+    const void *IndexOffset() const
+    {
+        return (const void *)indexOffset;
+    }
+};
+
+// One vertex and one index buffer shared by all static meshes of a vertex format, with a single VAO over them.
+// Meshes get appended and keep only their GeometryRange, so drawing any of them is one glDrawElementsBaseVertex
+// on the same VAO. Indices are relative to the mesh's base vertex, so they are stored as 16 bit whenever the
+// mesh has few enough vertices, both sizes mixed in one index buffer. When a buffer runs out it is replaced by one twice the size and the old contents are copied
+// over on the GPU; the VAO stays the same object, so the ranges handed out before stay valid.
+class GeometryBuffer
+{
+public:
+    // sets the attribute pointers of the format for the bound VAO and GL_ARRAY_BUFFER
+    typedef std::function<void()> AttributeSetup;
+
+    unsigned int VAO = 0;
+
+    GeometryBuffer(size_t vertexSize, const AttributeSetup &setupAttributes)
+        : vertexSize(vertexSize), setupAttributes(setupAttributes)
+    {
+    }
+
+    // appends the vertices and indices; indices stay relative to the mesh's first vertex
+    GeometryRange Allocate(const void *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
+    {
+        if (VAO == 0)
+            glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        if (vertexBytes + vertexCount * vertexSize > vertexCapacity)
+            grow(GL_ARRAY_BUFFER, VBO, vertexCapacity, vertexBytes, vertexBytes + vertexCount * vertexSize);
+        if (vertexCount > 0)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, vertexCount * vertexSize, vertices);
+        }
+        GeometryRange range;
+        range.baseVertex = (int)(vertexBytes / vertexSize);
+        appendIndices(range, vertexCount, indices, indexCount);
+        glBindVertexArray(0);
+
+        vertexBytes += vertexCount * vertexSize;
+        meshes++;
+        return range;
+    }
+
+    // appends another index list over the vertices of a range Allocate returned, e.g. a level of detail
+    GeometryRange AllocateIndices(const GeometryRange &vertices, size_t vertexCount, const unsigned int *indices,
+                                  size_t indexCount)
+    {
+        glBindVertexArray(VAO);
+        GeometryRange range;
+        range.baseVertex = vertices.baseVertex;
+        appendIndices(range, vertexCount, indices, indexCount);
+        glBindVertexArray(0);
+        return range;
+    }
+
+    // bytes in use and meshes stored
+    size_t VertexBytes() const
+    {
+        return vertexBytes;
+    }
+
+    size_t IndexBytes() const
+    {
+        return indexBytes;
+    }
+
+    unsigned int Meshes() const
+    {
+        return meshes;
+    }
+
+    void Release()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        if (VBO)
+            glDeleteBuffers(1, &VBO);
+        if (EBO)
+            glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        vertexBytes = indexBytes = vertexCapacity = indexCapacity = 0;
+        meshes = 0;
+    }
+
+private:
+    // first allocation of either buffer, large enough for a few of the scene's models
+    static const size_t INITIAL_CAPACITY = 4 * 1024 * 1024;
+
+    size_t vertexSize;
+    AttributeSetup setupAttributes;
+    unsigned int VBO = 0, EBO = 0;
+    size_t vertexBytes = 0, indexBytes = 0;
+    size_t vertexCapacity = 0, indexCapacity = 0;
+    unsigned int meshes = 0;
+
+    // writes the indices of range, as 16 bit if vertexCount allows; expects the VAO to be bound
+    void appendIndices(GeometryRange &range, size_t vertexCount, const unsigned int *indices, size_t indexCount)
+    {
+        range.indexCount = (unsigned int)indexCount;
+        range.indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        size_t indexSize = range.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        // indices have to start at a multiple of their size
+        size_t indexStart = (indexBytes + indexSize - 1) / indexSize * indexSize;
+        if (indexStart + indexCount * indexSize > indexCapacity)
+            grow(GL_ELEMENT_ARRAY_BUFFER, EBO, indexCapacity, indexBytes, indexStart + indexCount * indexSize);
+
+        range.indexOffset = indexStart;
+        if (indexCount > 0 && range.indexType == GL_UNSIGNED_SHORT)
+        {
+            std::vector<uint16_t> shortIndices(indices, indices + indexCount);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexStart, indexCount * indexSize, shortIndices.data());
+        }
+        else if (indexCount > 0)
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexStart, indexCount * indexSize, indices);
+        indexBytes = indexStart + indexCount * indexSize;
+    }
+
+    // replaces buffer by one that holds at least required bytes and copies the used part over; expects the VAO
+    // to be bound so the new buffer can be attached to it
+    void grow(GLenum target, unsigned int &buffer, size_t &capacity, size_t used, size_t required)
+    {
+        size_t newCapacity = std::max(capacity * 2, (size_t)INITIAL_CAPACITY);
+        while (newCapacity < required)
+            newCapacity *= 2;
+
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+        if (buffer)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = grown;
+        capacity = newCapacity;
+
+        // the index buffer binding is VAO state, the vertex buffer is captured by the attribute pointers
+        glBindBuffer(target, buffer);
+        if (target == GL_ARRAY_BUFFER)
+            setupAttributes();
+    }
+};
+
+// The geometry buffers of all vertex formats in use, one per format, and the format new meshes are packed in.
+class GeometryStore
+{
+public:
+    // what Mesh packs its vertices into, before the per-mesh fallback of VertexFormat::For
+    VertexFormat format;
+    // what the stored vertices would take as plain Vertex
+    size_t unpackedBytes = 0;
+
+    GeometryBuffer &For(const VertexFormat &vertexFormat)
+    {
+        std::unique_ptr<GeometryBuffer> &buffer = buffers[vertexFormat.Key()];
+        if (!buffer)
+            buffer.reset(new GeometryBuffer(vertexFormat.Stride(), [vertexFormat]() { vertexFormat.SetupAttributes(); }));
+        return *buffer;
+    }
+
+    size_t VertexBytes() const
+    {
+        size_t bytes = 0;
+        for (const std::pair<const unsigned int, std::unique_ptr<GeometryBuffer>> &buffer : buffers)
+            bytes += buffer.second->VertexBytes();
+        return bytes;
+    }
+
+    size_t IndexBytes() const
+    {
+        size_t bytes = 0;
+        for (const std::pair<const unsigned int, std::unique_ptr<GeometryBuffer>> &buffer : buffers)
+            bytes += buffer.second->IndexBytes();
+        return bytes;
+    }
+
+    unsigned int Meshes() const
+    {
+        unsigned int meshes = 0;
+        for (const std::pair<const unsigned int, std::unique_ptr<GeometryBuffer>> &buffer : buffers)
+            meshes += buffer.second->Meshes();
+        return meshes;
+    }
+
+    void Release()
+    {
+        for (std::pair<const unsigned int, std::unique_ptr<GeometryBuffer>> &buffer : buffers)
+            buffer.second->Release();
+        buffers.clear();
+        unpackedBytes = 0;
+    }
+
+private:
+    std::map<unsigned int, std::unique_ptr<GeometryBuffer>> buffers;
+};
+#endif
@@ -0,0 +1,139 @@
+#ifndef GL_COUNTERS_H
+#define GL_COUNTERS_H
+
+#include <glad/glad.h>
+
+// Counts draw calls, state changes and uniform uploads by swapping the glad entry points for thin wrappers,
+// so no call site has to be touched. Install() has to run after gladLoadGLLoader; until then nothing is counted.
+struct GLCallCounts {
+    unsigned int drawCalls = 0;
+    // program, vertex array, texture, buffer and framebuffer binds plus fixed function state
+    unsigned int stateChanges = 0;
+    unsigned int uniformUploads = 0;
+};
+
+class GLCallCounter
+{
+public:
+    // the calls counted since the last Reset()
+    static GLCallCounts &Counts()
+    {
+        static GLCallCounts counts;
+        return counts;
+    }
+
+    static void Install();
+
+    static void Reset()
+    {
+        Counts() = GLCallCounts();
+    }
+};
+
+// defines the wrapper counted_<name> that bumps counter and forwards to the entry point glad loaded, kept in
+// real_<name>(); both are inline so every translation unit shares them
+#define GL_COUNTED_CALL(type, name, counter, parameters, arguments) \
+    inline type &real_##name()                                      \
+    {                                                               \
+        static type entryPoint = nullptr;                           \
+        return entryPoint;                                          \
+    }                                                               \
+    inline void APIENTRY counted_##name parameters                  \
+    {                                                               \
+        GLCallCounter::Counts().counter++;                          \
+        real_##name() arguments;                                    \
+    }
+
+GL_COUNTED_CALL(PFNGLDRAWARRAYSPROC, glDrawArrays, drawCalls,
+                (GLenum mode, GLint first, GLsizei count), (mode, first, count))
+GL_COUNTED_CALL(PFNGLDRAWELEMENTSPROC, glDrawElements, drawCalls,
+                (GLenum mode, GLsizei count, GLenum type, const void *indices), (mode, count, type, indices))
+GL_COUNTED_CALL(PFNGLDRAWARRAYSINSTANCEDPROC, glDrawArraysInstanced, drawCalls,
+                (GLenum mode, GLint first, GLsizei count, GLsizei instances), (mode, first, count, instances))
+GL_COUNTED_CALL(PFNGLDRAWELEMENTSINSTANCEDPROC, glDrawElementsInstanced, drawCalls,
+                (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances),
+                (mode, count, type, indices, instances))
+GL_COUNTED_CALL(PFNGLDRAWELEMENTSBASEVERTEXPROC, glDrawElementsBaseVertex, drawCalls,
+                (GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex),
+                (mode, count, type, indices, baseVertex))
+GL_COUNTED_CALL(PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC, glDrawElementsInstancedBaseVertex, drawCalls,
+                (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances, GLint baseVertex),
+                (mode, count, type, indices, instances, baseVertex))
+
+GL_COUNTED_CALL(PFNGLUSEPROGRAMPROC, glUseProgram, stateChanges, (GLuint program), (program))
+GL_COUNTED_CALL(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray, stateChanges, (GLuint array), (array))
+GL_COUNTED_CALL(PFNGLBINDTEXTUREPROC, glBindTexture, stateChanges, (GLenum target, GLuint texture), (target, texture))
+GL_COUNTED_CALL(PFNGLACTIVETEXTUREPROC, glActiveTexture, stateChanges, (GLenum texture), (texture))
+GL_COUNTED_CALL(PFNGLBINDBUFFERPROC, glBindBuffer, stateChanges, (GLenum target, GLuint buffer), (target, buffer))
+GL_COUNTED_CALL(PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer, stateChanges, (GLenum target, GLuint framebuffer), (target, framebuffer))
+GL_COUNTED_CALL(PFNGLENABLEPROC, glEnable, stateChanges, (GLenum capability), (capability))
+GL_COUNTED_CALL(PFNGLDISABLEPROC, glDisable, stateChanges, (GLenum capability), (capability))
+GL_COUNTED_CALL(PFNGLDEPTHFUNCPROC, glDepthFunc, stateChanges, (GLenum function), (function))
+GL_COUNTED_CALL(PFNGLBLENDFUNCPROC, glBlendFunc, stateChanges, (GLenum source, GLenum destination), (source, destination))
+GL_COUNTED_CALL(PFNGLCULLFACEPROC, glCullFace, stateChanges, (GLenum mode), (mode))
+
+GL_COUNTED_CALL(PFNGLUNIFORM1IPROC, glUniform1i, uniformUploads, (GLint location, GLint v0), (location, v0))
+GL_COUNTED_CALL(PFNGLUNIFORM1FPROC, glUniform1f, uniformUploads, (GLint location, GLfloat v0), (location, v0))
+GL_COUNTED_CALL(PFNGLUNIFORM2FPROC, glUniform2f, uniformUploads,
+                (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1))
+GL_COUNTED_CALL(PFNGLUNIFORM3FPROC, glUniform3f, uniformUploads,
+                (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2))
+GL_COUNTED_CALL(PFNGLUNIFORM4FPROC, glUniform4f, uniformUploads,
+                (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3))
+GL_COUNTED_CALL(PFNGLUNIFORM2FVPROC, glUniform2fv, uniformUploads,
+                (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+GL_COUNTED_CALL(PFNGLUNIFORM3FVPROC, glUniform3fv, uniformUploads,
+                (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+GL_COUNTED_CALL(PFNGLUNIFORM4FVPROC, glUniform4fv, uniformUploads,
+                (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+GL_COUNTED_CALL(PFNGLUNIFORMMATRIX2FVPROC, glUniformMatrix2fv, uniformUploads,
+                (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+GL_COUNTED_CALL(PFNGLUNIFORMMATRIX3FVPROC, glUniformMatrix3fv, uniformUploads,
+                (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+GL_COUNTED_CALL(PFNGLUNIFORMMATRIX4FVPROC, glUniformMatrix4fv, uniformUploads,
+                (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+
+#undef GL_COUNTED_CALL
+
+// remembers the loaded entry point and puts the counting wrapper in its place
+#define GL_INSTALL_COUNTER(name)        \
+    if (!real_##name())                 \
+    {                                   \
+        real_##name() = glad_##name;    \
+        glad_##name = counted_##name;   \
+    }
+
+inline void GLCallCounter::Install()
+{
+    GL_INSTALL_COUNTER(glDrawArrays)
+    GL_INSTALL_COUNTER(glDrawElements)
+    GL_INSTALL_COUNTER(glDrawArraysInstanced)
+    GL_INSTALL_COUNTER(glDrawElementsInstanced)
+    GL_INSTALL_COUNTER(glDrawElementsBaseVertex)
+    GL_INSTALL_COUNTER(glDrawElementsInstancedBaseVertex)
+    GL_INSTALL_COUNTER(glUseProgram)
+    GL_INSTALL_COUNTER(glBindVertexArray)
+    GL_INSTALL_COUNTER(glBindTexture)
+    GL_INSTALL_COUNTER(glActiveTexture)
+    GL_INSTALL_COUNTER(glBindBuffer)
+    GL_INSTALL_COUNTER(glBindFramebuffer)
+    GL_INSTALL_COUNTER(glEnable)
+    GL_INSTALL_COUNTER(glDisable)
+    GL_INSTALL_COUNTER(glDepthFunc)
+    GL_INSTALL_COUNTER(glBlendFunc)
+    GL_INSTALL_COUNTER(glCullFace)
+    GL_INSTALL_COUNTER(glUniform1i)
+    GL_INSTALL_COUNTER(glUniform1f)
+    GL_INSTALL_COUNTER(glUniform2f)
+    GL_INSTALL_COUNTER(glUniform3f)
+    GL_INSTALL_COUNTER(glUniform4f)
+    GL_INSTALL_COUNTER(glUniform2fv)
+    GL_INSTALL_COUNTER(glUniform3fv)
+    GL_INSTALL_COUNTER(glUniform4fv)
+    GL_INSTALL_COUNTER(glUniformMatrix2fv)
+    GL_INSTALL_COUNTER(glUniformMatrix3fv)
+    GL_INSTALL_COUNTER(glUniformMatrix4fv)
+}
+
+#undef GL_INSTALL_COUNTER
+#endif
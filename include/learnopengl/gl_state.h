@@ -0,0 +1,166 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <cstdint>
+#include <unordered_map>
+
+// calls that reached GL and calls that were dropped because the state was already set
+struct GLStateCounts {
+    unsigned int issued = 0;
+    unsigned int skipped = 0;
+};
+
+// Shadows the bits of GL state the render queue changes and drops calls that would set what is already set.
+// The shadow is only right as long as nothing else touches that state, so Invalidate() has to be called whenever
+// other code (skybox, bloom, ImGui) may have run in between.
+class GLStateTracker
+{
+public:
+    GLStateCounts programs;
+    GLStateCounts vertexArrays;
+    GLStateCounts textures;
+    GLStateCounts samplers;
+    GLStateCounts capabilities;
+
+    GLStateTracker()
+    {
+        Invalidate();
+    }
+
+    // forgets everything, the next call of every kind goes through
+    void Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int &texture : boundTextures)
+            texture = UNKNOWN;
+        cullFace = UNKNOWN;
+        uniformInts.clear();
+        uniformVec3s.clear();
+    }
+
+    void ResetCounts()
+    {
+        programs = vertexArrays = textures = samplers = capabilities = GLStateCounts();
+    }
+
+    unsigned int Issued() const
+    {
+        return programs.issued + vertexArrays.issued + textures.issued + samplers.issued + capabilities.issued;
+    }
+
+    unsigned int Skipped() const
+    {
+        return programs.skipped + vertexArrays.skipped + textures.skipped + samplers.skipped + capabilities.skipped;
+    }
+
+    void UseProgram(unsigned int id)
+    {
+        if (!changes(program, id, programs))
+            return;
+        glUseProgram(id);
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (!changes(vertexArray, id, vertexArrays))
+            return;
+        glBindVertexArray(id);
+    }
+
+    // GL_TEXTURE_2D on the given unit, the active unit only changes when a bind is actually needed
+    void BindTexture(unsigned int unit, unsigned int id)
+    {
+        if (unit >= MAX_UNITS)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, id);
+            activeUnit = unit;
+            textures.issued++;
+            return;
+        }
+        if (!changes(boundTextures[unit], id, textures))
+            return;
+        if (activeUnit != unit)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+        }
+        glBindTexture(GL_TEXTURE_2D, id);
+    }
+
+    // integer uniforms (samplers, flags) are program state, remembered per program and location
+    void SetInt(const Shader &shader, UniformHandle handle, int value)
+    {
+        if (handle.index < 0)
+            return;
+        uint64_t key = ((uint64_t)shader.ID << 32) | (uint32_t)handle.index;
+        std::unordered_map<uint64_t, int>::iterator found = uniformInts.find(key);
+        if (found != uniformInts.end() && found->second == value)
+        {
+            samplers.skipped++;
+            return;
+        }
+        uniformInts[key] = value;
+        samplers.issued++;
+        shader.setInt(handle, value);
+    }
+
+    // same for per-mesh vec3 uniforms such as the position dequantization of packed vertices
+    void SetVec3(const Shader &shader, UniformHandle handle, const glm::vec3 &value)
+    {
+        if (handle.index < 0)
+            return;
+        uint64_t key = ((uint64_t)shader.ID << 32) | (uint32_t)handle.index;
+        std::unordered_map<uint64_t, glm::vec3>::iterator found = uniformVec3s.find(key);
+        if (found != uniformVec3s.end() && found->second == value)
+        {
+            samplers.skipped++;
+            return;
+        }
+        uniformVec3s[key] = value;
+        samplers.issued++;
+        shader.setVec3(handle, value);
+    }
+
+    void SetCullFace(bool enabled)
+    {
+        if (!changes(cullFace, enabled ? 1u : 0u, capabilities))
+            return;
+        if (enabled)
+            glEnable(GL_CULL_FACE);
+        else
+            glDisable(GL_CULL_FACE);
+    }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+    static const unsigned int MAX_UNITS = 16;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int boundTextures[MAX_UNITS];
+    unsigned int cullFace;
+    std::unordered_map<uint64_t, int> uniformInts;
+    std::unordered_map<uint64_t, glm::vec3> uniformVec3s;
+
+    static bool changes(unsigned int &current, unsigned int value, GLStateCounts &counts)
+    {
+        if (current == value)
+        {
+            counts.skipped++;
+            return false;
+        }
+        current = value;
+        counts.issued++;
+        return true;
+    }
+};
+#endif
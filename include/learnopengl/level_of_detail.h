@@ -0,0 +1,54 @@
+#ifndef LEVEL_OF_DETAIL_H
+#define LEVEL_OF_DETAIL_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Picks the level of detail of a mesh or model from how large its simplification error would be on screen: the
+// error, in model units, is scaled by the transform and projected at the distance of the nearest point of the
+// bounding sphere, and the coarsest level that stays within maxPixelError wins. Anything entirely beyond
+// maxDistance is not drawn at all, the scene uses the distance where the fog becomes opaque.
+struct LodSelector {
+    glm::vec3 camera = glm::vec3(0.0f);
+    // pixels one unit covers at distance one along the view direction
+    float pixelsPerUnit = 0.0f;
+    float maxDistance = std::numeric_limits<float>::max();
+    float maxPixelError = 1.0f;
+
+    LodSelector()
+    {
+    }
+
+    // fovy in degrees, as the camera keeps it
+    LodSelector(const glm::vec3 &camera, float fovy, float viewportHeight, float maxDistance)
+        : camera(camera), pixelsPerUnit(viewportHeight / (2.0f * std::tan(glm::radians(fovy) * 0.5f))),
+          maxDistance(maxDistance)
+    {
+    }
+
+    // the level to draw, 0 being the full mesh, or -1 if the bounds are too far away to be seen; errors holds the
+    // error of level 1 onwards
+    int Select(const std::vector<float> &errors, const BoundingVolume &bounds, const glm::mat4 &transform) const
+    {
+        if (bounds.empty)
+            return 0;
+        glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.center, 1.0f));
+        float scale = TransformScale(transform);
+        float distance = glm::length(center - camera) - bounds.radius * scale;
+        if (distance > maxDistance)
+            return -1;
+        if (distance <= 0.0f)
+            return 0;
+
+        int level = 0;
+        while (level < (int)errors.size() && errors[level] * scale * pixelsPerUnit / distance <= maxPixelError)
+            level++;
+        return level;
+    }
+};
+#endif
@@ -0,0 +1,339 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/lights.h>
+#include <learnopengl/shader.h>
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+// Clustered forward shading for the lamp lights (Olsson, Billeter, Assarsson 2012). The view frustum is cut into
+// TILES_X x TILES_Y screen tiles and SLICES depth slices, spaced exponentially between the near and far plane.
+// Every frame each light cone is tested against the bounding spheres of the clusters its own bounding sphere
+// touches, and the lights of every cluster go to the GPU as one compact index list. The fragment shader finds its
+// cluster from gl_FragCoord and the view space depth and loops over that cluster's lights only, so the cost per
+// pixel depends on how many lamps actually reach it, not on how many there are.
+// GL 3.3 has no storage buffers, the three arrays are texture buffers: the lights (five texels each, laid out
+// like GpuSpotLight), an (offset, count) pair per cluster and the light indices.
+class LightClusters
+{
+public:
+    // have to match resources/shaders/lights.glsl
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTERS = TILES_X * TILES_Y * SLICES;
+    // indices are 16 bit
+    static const unsigned int MAX_LIGHTS = 4096;
+    // texture units of the three buffers, above the ones meshes use for their materials
+    static const unsigned int LIGHT_UNIT = 13;
+    static const unsigned int CLUSTER_UNIT = 14;
+    static const unsigned int INDEX_UNIT = 15;
+
+    // lights and light references of the last Build, and the most any cluster got
+    unsigned int lightCount = 0;
+    unsigned int indexCount = 0;
+    unsigned int maxPerCluster = 0;
+
+    LightClusters()
+    {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // points the samplers of a program that includes lights.glsl at the buffers and resolves its cluster uniforms;
+    // every program Apply() is used with has to be bound first
+    void Bind(Shader &shader)
+    {
+        ClusterHandles &handles = programHandles[shader.ID];
+        handles.tileSize = shader.uniform("clusterTileSize");
+        handles.depth = shader.uniform("clusterDepth");
+        shader.use();
+        shader.setInt("lampLights", LIGHT_UNIT);
+        shader.setInt("lightClusters", CLUSTER_UNIT);
+        shader.setInt("lightIndices", INDEX_UNIT);
+    }
+
+    // starts collecting the lights of a frame
+    void Clear()
+    {
+        lights.clear();
+        ranges.clear();
+    }
+
+    void Add(const SpotLight &light)
+    {
+        if (lights.size() >= MAX_LIGHTS)
+            return;
+        lights.push_back(LightBuffer::Pack(light));
+        ranges.push_back(Range(light));
+    }
+
+    // bins the collected lights into the clusters of the view and uploads everything; fovy in degrees, width and
+    // height are the size of the framebuffer the scene is drawn into
+    void Build(const glm::mat4 &view, float fovy, float width, float height, float zNear, float zFar)
+    {
+        this->width = width;
+        this->height = height;
+        depthScale = (float)SLICES / std::log(zFar / zNear);
+        depthBias = -std::log(zNear) * depthScale;
+        computeClusterBounds(std::tan(glm::radians(fovy) * 0.5f), width / height, zNear, zFar);
+
+        references.clear();
+        for (unsigned int i = 0; i < lights.size(); i++)
+            binLight(view, i);
+
+        // counting sort of the (cluster, light) pairs into one list per cluster
+        std::fill(clusterRanges.begin(), clusterRanges.end(), 0u);
+        for (const std::pair<unsigned int, unsigned int> &reference : references)
+            clusterRanges[reference.first * 2 + 1]++;
+        unsigned int offset = 0;
+        maxPerCluster = 0;
+        for (unsigned int c = 0; c < CLUSTERS; c++)
+        {
+            clusterRanges[c * 2] = offset;
+            offset += clusterRanges[c * 2 + 1];
+            maxPerCluster = std::max(maxPerCluster, clusterRanges[c * 2 + 1]);
+        }
+        indices.resize(references.size());
+        next.assign(clusterRanges.begin(), clusterRanges.end());
+        for (const std::pair<unsigned int, unsigned int> &reference : references)
+            indices[next[reference.first * 2]++] = (uint16_t)reference.second;
+
+        lightCount = (unsigned int)lights.size();
+        indexCount = (unsigned int)indices.size();
+        upload(0, lights.data(), lights.size() * sizeof(GpuSpotLight));
+        upload(1, clusterRanges.data(), clusterRanges.size() * sizeof(uint32_t));
+        upload(2, indices.data(), indices.size() * sizeof(uint16_t));
+    }
+
+    // binds the buffers and sets the cluster uniforms for the program in use
+    void Apply(Shader &shader) const
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + LIGHT_UNIT + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        std::unordered_map<unsigned int, ClusterHandles>::const_iterator handles = programHandles.find(shader.ID);
+        if (handles == programHandles.end())
+            return;
+        shader.setVec2(handles->second.tileSize, glm::vec2(width / TILES_X, height / TILES_Y));
+        shader.setVec2(handles->second.depth, glm::vec2(depthScale, depthBias));
+    }
+
+    void Release()
+    {
+        glDeleteBuffers(3, buffers);
+        glDeleteTextures(3, textures);
+        programHandles.clear();
+    }
+
+    // distance at which the light adds less than LIGHT_THRESHOLD to any channel, the reach of its cone
+    static float Range(const SpotLight &light)
+    {
+        glm::vec3 total = light.ambient + light.diffuse + light.specular;
+        float brightest = std::max(total.x, std::max(total.y, total.z));
+        // brightest / (constant + linear d + quadratic d^2) = threshold
+        float c = light.constant - brightest / LIGHT_THRESHOLD;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (light.quadratic > 0.0f)
+            return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) /
+                   (2.0f * light.quadratic);
+        if (light.linear > 0.0f)
+            return -c / light.linear;
+        return MAX_RANGE;
+    }
+
+private:
+    // light below this is not worth a cluster entry
+    static constexpr float LIGHT_THRESHOLD = 1.0f / 256.0f;
+    static constexpr float MAX_RANGE = 1000.0f;
+
+    struct ClusterHandles {
+        UniformHandle tileSize;
+        UniformHandle depth;
+    };
+
+    unsigned int buffers[3];
+    unsigned int textures[3];
+    // uniform handles of every bound program, keyed by program id
+    std::unordered_map<unsigned int, ClusterHandles> programHandles;
+    float width = 1.0f, height = 1.0f;
+    // slice = log(depth) * depthScale + depthBias
+    float depthScale = 1.0f, depthBias = 0.0f;
+
+    std::vector<GpuSpotLight> lights;
+    std::vector<float> ranges;
+    // view space bounding sphere of every cluster, xyz center and w radius
+    std::vector<glm::vec4> clusterSpheres;
+    std::vector<std::pair<unsigned int, unsigned int>> references;
+    std::vector<uint32_t> clusterRanges = std::vector<uint32_t>(CLUSTERS * 2);
+    std::vector<uint32_t> next;
+    std::vector<uint16_t> indices;
+    // tangent of the half field of view and aspect, and near and far, the cluster bounds were computed for
+    float tanHalfFov = 0.0f, aspect = 0.0f, zNear = 0.0f, zFar = 0.0f;
+
+    float sliceDepth(unsigned int slice) const
+    {
+        return zNear * std::pow(zFar / zNear, (float)slice / SLICES);
+    }
+
+    // the clusters only change with the projection
+    void computeClusterBounds(float tanHalfFov, float aspect, float zNear, float zFar)
+    {
+        if (!clusterSpheres.empty() && tanHalfFov == this->tanHalfFov && aspect == this->aspect &&
+            zNear == this->zNear && zFar == this->zFar)
+            return;
+        this->tanHalfFov = tanHalfFov;
+        this->aspect = aspect;
+        this->zNear = zNear;
+        this->zFar = zFar;
+
+        clusterSpheres.resize(CLUSTERS);
+        for (unsigned int slice = 0; slice < SLICES; slice++)
+        {
+            float depths[2] = {sliceDepth(slice), sliceDepth(slice + 1)};
+            for (unsigned int y = 0; y < TILES_Y; y++)
+            {
+                for (unsigned int x = 0; x < TILES_X; x++)
+                {
+                    glm::vec3 minimum(0.0f), maximum(0.0f);
+                    for (unsigned int corner = 0; corner < 8; corner++)
+                    {
+                        float depth = depths[corner >> 2];
+                        float ndcX = -1.0f + 2.0f * (float)(x + (corner & 1)) / TILES_X;
+                        float ndcY = -1.0f + 2.0f * (float)(y + ((corner >> 1) & 1)) / TILES_Y;
+                        glm::vec3 point(ndcX * depth * tanHalfFov * aspect, ndcY * depth * tanHalfFov, -depth);
+                        minimum = corner == 0 ? point : glm::min(minimum, point);
+                        maximum = corner == 0 ? point : glm::max(maximum, point);
+                    }
+                    glm::vec3 center = (minimum + maximum) * 0.5f;
+                    clusterSpheres[x + TILES_X * (y + TILES_Y * slice)] = glm::vec4(center, glm::length(maximum - center));
+                }
+            }
+        }
+    }
+
+    // adds a reference for every cluster the cone of light index intersects
+    void binLight(const glm::mat4 &view, unsigned int index)
+    {
+        const GpuSpotLight &light = lights[index];
+        float range = ranges[index];
+        if (range <= 0.0f)
+            return;
+        glm::vec3 apex = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        glm::vec3 axis = glm::vec3(view * glm::vec4(light.direction, 0.0f));
+        float axisLength = glm::length(axis);
+        if (axisLength <= 0.0f)
+            return;
+        axis /= axisLength;
+        float cosAngle = std::max(-1.0f, std::min(1.0f, light.outerCutOff));
+        float sinAngle = std::sqrt(1.0f - cosAngle * cosAngle);
+
+        // sphere around the cone, the tighter of the two that contain it depending on how wide it is
+        glm::vec3 center;
+        float radius;
+        if (cosAngle < 0.70710678f)
+        {
+            center = apex + axis * (range * std::max(cosAngle, 0.0f));
+            radius = cosAngle > 0.0f ? range * sinAngle : range;
+        }
+        else
+        {
+            radius = range / (2.0f * cosAngle);
+            center = apex + axis * radius;
+        }
+
+        // slices and tiles that sphere's box covers
+        float nearest = -center.z - radius, farthest = -center.z + radius;
+        if (farthest < zNear || nearest > zFar)
+            return;
+        unsigned int firstSlice = slice(nearest), lastSlice = slice(farthest);
+        unsigned int firstX = 0, lastX = TILES_X - 1, firstY = 0, lastY = TILES_Y - 1;
+        if (nearest > zNear)
+        {
+            // x / -z is largest and smallest at the corners of the box
+            float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+            for (unsigned int corner = 0; corner < 4; corner++)
+            {
+                float x = center.x + ((corner & 1) ? radius : -radius);
+                float y = center.y + ((corner & 2) ? radius : -radius);
+                for (float depth : {nearest, farthest})
+                {
+                    minX = std::min(minX, x / depth);
+                    maxX = std::max(maxX, x / depth);
+                    minY = std::min(minY, y / depth);
+                    maxY = std::max(maxY, y / depth);
+                }
+            }
+            firstX = tile(minX / (tanHalfFov * aspect), TILES_X);
+            lastX = tile(maxX / (tanHalfFov * aspect), TILES_X);
+            firstY = tile(minY / tanHalfFov, TILES_Y);
+            lastY = tile(maxY / tanHalfFov, TILES_Y);
+        }
+
+        for (unsigned int s = firstSlice; s <= lastSlice; s++)
+            for (unsigned int y = firstY; y <= lastY; y++)
+                for (unsigned int x = firstX; x <= lastX; x++)
+                {
+                    unsigned int cluster = x + TILES_X * (y + TILES_Y * s);
+                    if (coneTouches(apex, axis, range, cosAngle, sinAngle, clusterSpheres[cluster]))
+                        references.push_back(std::make_pair(cluster, index));
+                }
+    }
+
+    unsigned int slice(float depth) const
+    {
+        if (depth <= zNear)
+            return 0;
+        float s = std::log(depth) * depthScale + depthBias;
+        return (unsigned int)std::min(std::max(s, 0.0f), (float)(SLICES - 1));
+    }
+
+    static unsigned int tile(float ndc, unsigned int tiles)
+    {
+        float t = (ndc * 0.5f + 0.5f) * tiles;
+        return (unsigned int)std::min(std::max(t, 0.0f), (float)(tiles - 1));
+    }
+
+    // cone against sphere, conservative: the sphere's distance to the cone's side, its front cap and its apex
+    static bool coneTouches(const glm::vec3 &apex, const glm::vec3 &axis, float range, float cosAngle, float sinAngle,
+                            const glm::vec4 &sphere)
+    {
+        glm::vec3 toCenter = glm::vec3(sphere) - apex;
+        float along = glm::dot(toCenter, axis);
+        float across = std::sqrt(std::max(glm::dot(toCenter, toCenter) - along * along, 0.0f));
+        float sideDistance = cosAngle * across - sinAngle * along;
+        return sideDistance <= sphere.w && along <= range + sphere.w && along >= -sphere.w;
+    }
+
+    void upload(unsigned int buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        // a new store every frame lets the driver orphan the one the last frame still reads
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), nullptr, GL_STREAM_DRAW);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+#endif
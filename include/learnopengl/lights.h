@@ -0,0 +1,167 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+struct DirLight {
+    glm::vec3 direction;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+struct SpotLight {
+    glm::vec3 position;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+// std140 images of the structs in the Lights uniform block
+struct GpuDirLight {
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+struct GpuSpotLight {
+    glm::vec3 position;
+    float cutOff;
+    glm::vec3 direction;
+    float outerCutOff;
+
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+
+struct GpuLightBlock {
+    GpuDirLight dirLight;
+    GpuSpotLight spotLight;
+    GpuSpotLight spotLight1;
+};
+
+static_assert(sizeof(GpuDirLight) == 64, "GpuDirLight must match the std140 layout of DirLight");
+static_assert(sizeof(GpuSpotLight) == 80, "GpuSpotLight must match the std140 layout of SpotLight");
+
+// Owns the Lights uniform buffer. Setters write into a CPU copy of the block and only widen the
+// dirty byte range when something actually changed, Upload() then sends that range in one call.
+// The street lamps are not part of the block, they go through LightClusters.
+class LightBuffer
+{
+public:
+    // uniform buffer binding point shared by every program that includes lights.glsl
+    static const unsigned int BINDING = 0;
+
+    unsigned int UBO;
+    // bytes sent by the last Upload(), 0 when nothing changed
+    unsigned int uploadedBytes = 0;
+
+    LightBuffer()
+    {
+        block = GpuLightBlock();
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(GpuLightBlock), &block, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, UBO);
+    }
+
+    // connects the Lights block of a program to this buffer
+    void Bind(Shader &shader) const
+    {
+        shader.bindUniformBlock("Lights", BINDING);
+    }
+
+    void SetDirLight(const DirLight &light)
+    {
+        GpuDirLight gpu = GpuDirLight();
+        gpu.direction = light.direction;
+        gpu.ambient = light.ambient;
+        gpu.diffuse = light.diffuse;
+        gpu.specular = light.specular;
+        write(offsetof(GpuLightBlock, dirLight), &gpu, sizeof(gpu));
+    }
+
+    // car headlights, index 0 is spotLight and 1 is spotLight1 in the shader
+    void SetSpotLight(unsigned int index, const SpotLight &light)
+    {
+        size_t offset = index == 0 ? offsetof(GpuLightBlock, spotLight) : offsetof(GpuLightBlock, spotLight1);
+        GpuSpotLight gpu = Pack(light);
+        write(offset, &gpu, sizeof(gpu));
+    }
+
+    // sends the dirty range, if any, with a single glBufferSubData
+    void Upload()
+    {
+        uploadedBytes = 0;
+        if (dirtyBegin >= dirtyEnd)
+            return;
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, dirtyBegin, dirtyEnd - dirtyBegin, reinterpret_cast<const char*>(&block) + dirtyBegin);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploadedBytes = (unsigned int)(dirtyEnd - dirtyBegin);
+        dirtyBegin = sizeof(GpuLightBlock);
+        dirtyEnd = 0;
+    }
+
+    void Release()
+    {
+        glDeleteBuffers(1, &UBO);
+    }
+
+    static GpuSpotLight Pack(const SpotLight &light)
+    {
+        GpuSpotLight gpu;
+        gpu.position = light.position;
+        gpu.cutOff = light.cutOff;
+        gpu.direction = light.direction;
+        gpu.outerCutOff = light.outerCutOff;
+        gpu.ambient = light.ambient;
+        gpu.constant = light.constant;
+        gpu.diffuse = light.diffuse;
+        gpu.linear = light.linear;
+        gpu.specular = light.specular;
+        gpu.quadratic = light.quadratic;
+        return gpu;
+    }
+
+private:
+    GpuLightBlock block;
+    size_t dirtyBegin = 0;
+    size_t dirtyEnd = sizeof(GpuLightBlock);
+
+    void write(size_t offset, const void *data, size_t size)
+    {
+        char *target = reinterpret_cast<char*>(&block) + offset;
+        if (std::memcmp(target, data, size) == 0)
+            return;
+        std::memcpy(target, data, size);
+        dirtyBegin = std::min(dirtyBegin, offset);
+        dirtyEnd = std::max(dirtyEnd, offset + size);
+    }
+};
+#endif
@@ -7,63 +7,220 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/geometry_buffer.h>
+#include <learnopengl/vertex_format.h>
 
 #include <string>
 #include <vector>
+#include <utility>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-};
-
-
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// material texture as referenced by the model file, turned into a Texture when the mesh is created
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// simulated post-transform cache misses of a mesh's index list before and after MeshOptimizer reordered it;
+// ACMR is misses per triangle (0.5 at best), ATVR misses per vertex (1.0 at best)
+struct VertexCacheStats {
+    unsigned int triangles = 0;
+    unsigned int vertices = 0;
+    unsigned int missesBefore = 0;
+    unsigned int missesAfter = 0;
+
+    void Add(const VertexCacheStats &other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        missesBefore += other.missesBefore;
+        missesAfter += other.missesAfter;
+    }
+
+    float ACMR(unsigned int misses) const
+    {
+        return triangles ? (float)misses / triangles : 0.0f;
+    }
+
+    float ATVR(unsigned int misses) const
+    {
+        return vertices ? (float)misses / vertices : 0.0f;
+    }
+};
+
+// a coarser version of a mesh: triangles over the same vertices, and how far, at most, they are off the full mesh
+struct MeshLod {
+    vector<unsigned int> indices;
+    float error = 0.0f;
+};
+
+// CPU side of a mesh, filled by Assimp or the binary mesh cache before anything touches GL
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<TextureRef>   textures;
+    VertexCacheStats     cacheStats;
+    // from fine to coarse, see MeshSimplifier
+    vector<MeshLod>      lods;
+};
+
 class Mesh {
 public:
     // mesh Data
-    vector<Vertex>       vertices;
-    vector<unsigned int> indices;
     vector<Texture>      textures;
 
+    // VAO shared by every mesh of this vertex format and the part of its buffers that holds this mesh
     unsigned int VAO;
+    GeometryRange geometry;
+    VertexFormat format;
+    // index ranges of the coarser levels of detail over the same vertices and their errors, level 1 first
+    vector<GeometryRange> lods;
+    vector<float> lodErrors;
+    // turn the stored position back into the model space one: scale * aPos + offset
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    // box and sphere around the vertices, in model space
+    BoundingVolume bounds;
+    // ShaderVariants material features the textures need, set by Model
+    unsigned int features = 0;
     std::string glslIdentifierPrefix;
+    // sampler uniform of every texture, resolved against the shader that last drew this mesh
+    vector<UniformHandle> samplerHandles;
+    // positionScale and positionOffset of the same shader, for Draw
+    UniformHandle positionScaleHandle, positionOffsetHandle;
+    unsigned int samplerShaderID = 0;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // the vertices are packed in the store's format and go to the shared geometry buffer of that format, the mesh
+    // keeps no copy of them
+    Mesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, vector<Texture> textures,
+         const vector<MeshLod> &levels = vector<MeshLod>())
+    {
+        this->textures = std::move(textures);
+
+        for (const Vertex &vertex : vertices)
+            bounds.Extend(vertex.Position);
+        bounds.Finish();
+
+        GeometryStore &store = StaticGeometry();
+        format = store.format.For(bounds);
+        vector<unsigned char> packed;
+        format.Pack(vertices, bounds, packed, positionScale, positionOffset);
+        GeometryBuffer &buffer = store.For(format);
+        geometry = buffer.Allocate(packed.data(), vertices.size(), indices.data(), indices.size());
+        for (const MeshLod &level : levels)
+        {
+            lods.push_back(buffer.AllocateIndices(geometry, vertices.size(), level.indices.data(), level.indices.size()));
+            lodErrors.push_back(level.error);
+        }
+        store.unpackedBytes += vertices.size() * sizeof(Vertex);
+        VAO = buffer.VAO;
+    }
+
+    // the triangles of a level of detail, levels past the coarsest one the mesh has get that one
+    const GeometryRange &Lod(unsigned int level) const
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        if (level == 0 || lods.empty())
+            return geometry;
+        return lods[std::min(level, (unsigned int)lods.size()) - 1];
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // buffers and VAOs that hold every mesh, one per vertex format
+    static GeometryStore &StaticGeometry()
+    {
+        static GeometryStore store;
+        return store;
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
+        bindTextures(shader);
+
+        // draw mesh
+        shader.setVec3(positionScaleHandle, positionScale);
+        shader.setVec3(positionOffsetHandle, positionOffset);
+        glBindVertexArray(VAO);
+        DisableInstanceAttributes();
+        glDrawElementsBaseVertex(GL_TRIANGLES, geometry.indexCount, geometry.indexType, geometry.IndexOffset(), geometry.baseVertex);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // feeds a mat4 per instance from instanceVBO, starting at offset bytes, into attribute locations 5-8;
+    // expects this mesh's VAO to be bound
+    void SetupInstanceAttributes(unsigned int instanceVBO, size_t offset)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+    }
+
+    // turns locations 5-8 back into a constant identity matrix for draws without instances, so they never fetch
+    // from an instance buffer that was respecified since; expects this mesh's VAO to be bound
+    void DisableInstanceAttributes()
+    {
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glDisableVertexAttribArray(5 + column);
+            glVertexAttrib4f(5 + column, column == 0 ? 1.0f : 0.0f, column == 1 ? 1.0f : 0.0f,
+                             column == 2 ? 1.0f : 0.0f, column == 3 ? 1.0f : 0.0f);
+        }
+    }
+
+    // sampler uniform of every texture in shader, in the order of textures
+    const vector<UniformHandle> &SamplerHandles(const Shader &shader)
+    {
+        if (samplerShaderID != shader.ID)
+            resolveSamplerHandles(shader);
+        return samplerHandles;
+    }
+
+    // forgets the resolved sampler handles, e.g. after the texture name prefix changed
+    void ResetSamplerHandles()
+    {
+        samplerShaderID = 0;
+    }
+
+private:
+    void bindTextures(Shader &shader)
+    {
+        // sampler handles are resolved once per shader, afterwards binding is plain array indexing
+        SamplerHandles(shader);
         // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            shader.setInt(samplerHandles[i], i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // builds the sampler uniform names (diffuse_textureN, specular_textureN, ...) and resolves them, and the position
+    // unpacking uniforms, against the shader
+    void resolveSamplerHandles(const Shader &shader)
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerHandles.clear();
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,65 +232,11 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerHandles.push_back(shader.uniform(glslIdentifierPrefix + name + number));
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
-    }
-
-private:
-    // render data
-    unsigned int VBO, EBO;
-
-    // initializes all the buffer objects/arrays
-    void setupMesh()
-    {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        positionScaleHandle = shader.uniform("positionScale");
+        positionOffsetHandle = shader.uniform("positionOffset");
+        samplerShaderID = shader.ID;
     }
 };
 #endif
\ No newline at end of file
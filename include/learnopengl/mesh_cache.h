@@ -0,0 +1,280 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary cache of the imported meshes of a model, written next to the source asset as <asset>.meshcache.
+// Layout: MeshCacheHeader, then per mesh a MeshCacheEntry followed by its vertices, indices and
+// texture references (uint32 length + bytes for type and path) and its levels of detail (uint32 index count,
+// float error, indices), every block padded to 4 bytes. The meshes are stored after MeshOptimizer and
+// MeshSimplifier, together with the cache statistics the optimizer measured.
+// The cache is only used when version, vertex layout and the hash of the source file all match.
+const uint32_t MESH_CACHE_VERSION = 3;
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+struct MeshCacheEntry {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    // VertexCacheStats, the vertex count is the one before optimization
+    uint32_t originalVertexCount;
+    uint32_t missesBefore;
+    uint32_t missesAfter;
+    uint32_t reserved2;
+};
+
+class MeshCache
+{
+public:
+    static std::string CachePath(const std::string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // maps the cache of sourcePath and fills meshes from it, returns false if there is no valid cache
+    static bool Load(const std::string &sourcePath, std::vector<MeshData> &meshes)
+    {
+        uint64_t sourceHash, sourceSize;
+        if (!hashFile(sourcePath, sourceHash, sourceSize))
+            return false;
+
+        int fd = open(CachePath(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(MeshCacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+        size_t size = (size_t)info.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            return false;
+
+        const char *begin = static_cast<const char*>(mapping);
+        const char *cursor = begin;
+        const char *end = begin + size;
+        bool valid = parse(cursor, end, sourceHash, sourceSize, meshes);
+        munmap(mapping, size);
+        if (!valid)
+            meshes.clear();
+        return valid;
+    }
+
+    // writes the cache for sourcePath, goes through a temporary file so a concurrent reader never sees half a cache
+    static void Save(const std::string &sourcePath, const std::vector<MeshData> &meshes)
+    {
+        uint64_t sourceHash, sourceSize;
+        if (!hashFile(sourcePath, sourceHash, sourceSize))
+            return;
+
+        std::string cachePath = CachePath(sourcePath);
+        std::string temporaryPath = cachePath + ".tmp";
+        std::ofstream out(temporaryPath, std::ios::binary);
+        if (!out)
+            return;
+
+        MeshCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "LOGLMSH", 8);
+        header.version = MESH_CACHE_VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceHash = sourceHash;
+        header.sourceSize = sourceSize;
+        header.meshCount = (uint32_t)meshes.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (const MeshData &mesh : meshes)
+        {
+            MeshCacheEntry entry;
+            entry.vertexCount = (uint32_t)mesh.vertices.size();
+            entry.indexCount = (uint32_t)mesh.indices.size();
+            entry.textureCount = (uint32_t)mesh.textures.size();
+            entry.lodCount = (uint32_t)mesh.lods.size();
+            entry.originalVertexCount = mesh.cacheStats.vertices;
+            entry.missesBefore = mesh.cacheStats.missesBefore;
+            entry.missesAfter = mesh.cacheStats.missesAfter;
+            entry.reserved2 = 0;
+            out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+            out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+            for (const TextureRef &texture : mesh.textures)
+            {
+                writeString(out, texture.type);
+                writeString(out, texture.path);
+            }
+            for (const MeshLod &lod : mesh.lods)
+            {
+                uint32_t indexCount = (uint32_t)lod.indices.size();
+                out.write(reinterpret_cast<const char*>(&indexCount), sizeof(indexCount));
+                out.write(reinterpret_cast<const char*>(&lod.error), sizeof(lod.error));
+                out.write(reinterpret_cast<const char*>(lod.indices.data()), lod.indices.size() * sizeof(unsigned int));
+            }
+        }
+        out.close();
+        if (!out || std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::cout << "MESH_CACHE:: failed to write " << cachePath << std::endl;
+            std::remove(temporaryPath.c_str());
+        }
+    }
+
+    // 64-bit FNV-1a style hash of the file contents, folded eight bytes at a time
+    static bool hashFile(const std::string &path, uint64_t &hash, uint64_t &size)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        hash = 14695981039346656037ULL;
+        size = 0;
+        std::vector<char> buffer(1 << 16);
+        while (in)
+        {
+            in.read(buffer.data(), buffer.size());
+            size_t count = (size_t)in.gcount();
+            size_t words = count / 8;
+            for (size_t i = 0; i < words; i++)
+            {
+                uint64_t word;
+                std::memcpy(&word, buffer.data() + i * 8, 8);
+                hash = (hash ^ word) * 1099511628211ULL;
+            }
+            for (size_t i = words * 8; i < count; i++)
+                hash = (hash ^ (unsigned char)buffer[i]) * 1099511628211ULL;
+            size += count;
+        }
+        return true;
+    }
+
+private:
+    static size_t padding(size_t size)
+    {
+        return (4 - size % 4) % 4;
+    }
+
+    static void writeString(std::ofstream &out, const std::string &value)
+    {
+        static const char zeros[4] = {0, 0, 0, 0};
+        uint32_t length = (uint32_t)value.size();
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(value.data(), value.size());
+        out.write(zeros, padding(value.size()));
+    }
+
+    static bool read(const char *&cursor, const char *end, void *target, size_t size)
+    {
+        if ((size_t)(end - cursor) < size)
+            return false;
+        std::memcpy(target, cursor, size);
+        cursor += size;
+        return true;
+    }
+
+    // whether count records of at least size bytes each can still be in the file
+    static bool fits(const char *cursor, const char *end, uint64_t count, size_t size)
+    {
+        return count <= (uint64_t)(end - cursor) / size;
+    }
+
+    static bool readString(const char *&cursor, const char *end, std::string &value)
+    {
+        uint32_t length;
+        if (!read(cursor, end, &length, sizeof(length)) || (size_t)(end - cursor) < length + padding(length))
+            return false;
+        value.assign(cursor, length);
+        cursor += length + padding(length);
+        return true;
+    }
+
+    static bool parse(const char *&cursor, const char *end, uint64_t sourceHash, uint64_t sourceSize, std::vector<MeshData> &meshes)
+    {
+        MeshCacheHeader header;
+        if (!read(cursor, end, &header, sizeof(header)))
+            return false;
+        if (std::memcmp(header.magic, "LOGLMSH", 8) != 0 || header.version != MESH_CACHE_VERSION ||
+            header.vertexSize != sizeof(Vertex) || header.sourceHash != sourceHash || header.sourceSize != sourceSize)
+            return false;
+
+        // every count is bounded by the bytes left before anything is sized by it, a damaged file falls back to Assimp
+        if (!fits(cursor, end, header.meshCount, sizeof(MeshCacheEntry)))
+            return false;
+        meshes.resize(header.meshCount);
+        for (MeshData &mesh : meshes)
+        {
+            MeshCacheEntry entry;
+            if (!read(cursor, end, &entry, sizeof(entry)))
+                return false;
+            size_t vertexBytes = (size_t)entry.vertexCount * sizeof(Vertex);
+            size_t indexBytes = (size_t)entry.indexCount * sizeof(unsigned int);
+            if ((size_t)(end - cursor) < vertexBytes + indexBytes)
+                return false;
+            const Vertex *vertices = reinterpret_cast<const Vertex*>(cursor);
+            mesh.vertices.assign(vertices, vertices + entry.vertexCount);
+            cursor += vertexBytes;
+            const unsigned int *indices = reinterpret_cast<const unsigned int*>(cursor);
+            mesh.indices.assign(indices, indices + entry.indexCount);
+            cursor += indexBytes;
+            for (unsigned int index : mesh.indices)
+                if (index >= entry.vertexCount)
+                    return false;
+            mesh.cacheStats.triangles = entry.indexCount / 3;
+            mesh.cacheStats.vertices = entry.originalVertexCount;
+            mesh.cacheStats.missesBefore = entry.missesBefore;
+            mesh.cacheStats.missesAfter = entry.missesAfter;
+            // a texture is at least the lengths of its type and path
+            if (!fits(cursor, end, entry.textureCount, 2 * sizeof(uint32_t)))
+                return false;
+            mesh.textures.resize(entry.textureCount);
+            for (TextureRef &texture : mesh.textures)
+            {
+                if (!readString(cursor, end, texture.type) || !readString(cursor, end, texture.path))
+                    return false;
+            }
+            if (!fits(cursor, end, entry.lodCount, sizeof(uint32_t) + sizeof(float)))
+                return false;
+            mesh.lods.resize(entry.lodCount);
+            for (MeshLod &lod : mesh.lods)
+            {
+                uint32_t indexCount;
+                if (!read(cursor, end, &indexCount, sizeof(indexCount)) || !read(cursor, end, &lod.error, sizeof(lod.error)))
+                    return false;
+                size_t lodBytes = (size_t)indexCount * sizeof(unsigned int);
+                if ((size_t)(end - cursor) < lodBytes)
+                    return false;
+                const unsigned int *lodIndices = reinterpret_cast<const unsigned int*>(cursor);
+                lod.indices.assign(lodIndices, lodIndices + indexCount);
+                cursor += lodBytes;
+                for (unsigned int index : lod.indices)
+                    if (index >= entry.vertexCount)
+                        return false;
+            }
+        }
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,246 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <vector>
+
+// Reorders a freshly imported mesh for the GPU, once, before it goes into the mesh cache:
+// 1. triangles with Tipsify (Sander, Nehab, Barczak 2007) so neighbouring triangles reuse the post-transform
+//    vertex cache,
+// 2. the clusters Tipsify produces (runs between two cache flushes) sorted so outward facing ones come first,
+//    which lets the depth test reject more of the rest of the mesh,
+// 3. vertices in the order the indices first use them, so vertex fetch walks the buffer front to back;
+//    vertices no triangle uses are dropped.
+// Triangle lists only, anything else is left as it is.
+class MeshOptimizer
+{
+public:
+    // entries of the simulated FIFO vertex cache, for both the optimization and the statistics
+    static const unsigned int CACHE_SIZE = 16;
+
+    static void Optimize(MeshData &mesh)
+    {
+        mesh.cacheStats.triangles = (unsigned int)(mesh.indices.size() / 3);
+        mesh.cacheStats.vertices = (unsigned int)mesh.vertices.size();
+        mesh.cacheStats.missesBefore = CacheMisses(mesh.indices, mesh.vertices.size());
+        mesh.cacheStats.missesAfter = mesh.cacheStats.missesBefore;
+        if (mesh.indices.empty() || mesh.indices.size() % 3 != 0)
+            return;
+        for (unsigned int index : mesh.indices)
+            if (index >= mesh.vertices.size())
+                return;
+
+        std::vector<unsigned int> clusters;
+        std::vector<unsigned int> indices = tipsify(mesh.indices, mesh.vertices.size(), clusters);
+        mesh.indices = sortClusters(indices, clusters, mesh.vertices);
+        reorderVertices(mesh);
+
+        mesh.cacheStats.vertices = (unsigned int)mesh.vertices.size();
+        mesh.cacheStats.missesAfter = CacheMisses(mesh.indices, mesh.vertices.size());
+    }
+
+    // only the Tipsify pass, for index lists that share their vertices with another one
+    static void OptimizeTriangles(std::vector<unsigned int> &indices, size_t vertexCount)
+    {
+        if (indices.empty() || indices.size() % 3 != 0)
+            return;
+        std::vector<unsigned int> clusters;
+        indices = tipsify(indices, vertexCount, clusters);
+    }
+
+    // transforms a FIFO cache of CACHE_SIZE entries would do for the index list
+    static unsigned int CacheMisses(const std::vector<unsigned int> &indices, size_t vertexCount)
+    {
+        std::vector<unsigned int> insertedAt(vertexCount, 0);
+        unsigned int misses = 0;
+        for (unsigned int index : indices)
+        {
+            if (index >= vertexCount)
+                continue;
+            // a vertex is still cached when fewer than CACHE_SIZE others were inserted after it
+            if (insertedAt[index] == 0 || misses - insertedAt[index] >= CACHE_SIZE)
+            {
+                misses++;
+                insertedAt[index] = misses;
+            }
+        }
+        return misses;
+    }
+
+private:
+    // clusters shorter than this are merged into the next one, the sort gains little from tiny ones and every
+    // boundary costs a cold cache
+    static const unsigned int MIN_CLUSTER_TRIANGLES = 64;
+
+    // Tipsify: fans around one vertex at a time and moves on to the neighbour that is still in the cache and has
+    // the fewest triangles left, or to a vertex of the dead-end stack when none is. clusters gets the first
+    // triangle of every run that had to fall back to the dead-end stack, where locality is lost anyway.
+    static std::vector<unsigned int> tipsify(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                             std::vector<unsigned int> &clusters)
+    {
+        size_t triangleCount = indices.size() / 3;
+        // triangles around every vertex, as offsets into one array
+        std::vector<unsigned int> live(vertexCount, 0);
+        for (unsigned int index : indices)
+            live[index]++;
+        std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[filled[indices[i]]++] = (unsigned int)(i / 3);
+
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+        unsigned int time = CACHE_SIZE + 1;
+        size_t cursor = 0;
+
+        int fanning = 0;
+        clusters.push_back(0);
+        while (fanning >= 0)
+        {
+            candidates.clear();
+            for (unsigned int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+            {
+                unsigned int triangle = adjacency[a];
+                if (emitted[triangle])
+                    continue;
+                for (unsigned int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int v = indices[triangle * 3 + corner];
+                    output.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cacheTime[v] > CACHE_SIZE)
+                        cacheTime[v] = time++;
+                }
+                emitted[triangle] = true;
+            }
+
+            // the neighbour that stays in the cache longest once its remaining triangles are emitted
+            int next = -1;
+            int best = -1;
+            for (unsigned int v : candidates)
+            {
+                if (live[v] == 0)
+                    continue;
+                int priority = 0;
+                if (time - cacheTime[v] + 2 * live[v] <= CACHE_SIZE)
+                    priority = (int)(time - cacheTime[v]);
+                if (priority > best)
+                {
+                    best = priority;
+                    next = (int)v;
+                }
+            }
+            if (next < 0)
+            {
+                next = skipDeadEnd(live, deadEnd, cursor);
+                if (next >= 0 && output.size() / 3 > clusters.back())
+                    clusters.push_back((unsigned int)(output.size() / 3));
+            }
+            fanning = next;
+        }
+        return output;
+    }
+
+    static int skipDeadEnd(const std::vector<unsigned int> &live, std::vector<unsigned int> &deadEnd, size_t &cursor)
+    {
+        while (!deadEnd.empty())
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                return (int)v;
+        }
+        for (; cursor < live.size(); cursor++)
+            if (live[cursor] > 0)
+                return (int)cursor;
+        return -1;
+    }
+
+    // orders the clusters by how far they face out of the mesh: dot(cluster center - mesh center, cluster normal)
+    static std::vector<unsigned int> sortClusters(const std::vector<unsigned int> &indices, std::vector<unsigned int> clusters,
+                                                  const std::vector<Vertex> &vertices)
+    {
+        unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+        // merge the short ones
+        std::vector<unsigned int> merged;
+        for (unsigned int start : clusters)
+            if (merged.empty() || start - merged.back() >= MIN_CLUSTER_TRIANGLES)
+                merged.push_back(start);
+        if (merged.size() < 2)
+            return indices;
+        merged.push_back(triangleCount);
+
+        glm::vec3 meshCenter(0.0f);
+        for (unsigned int index : indices)
+            meshCenter += vertices[index].Position;
+        meshCenter /= (float)indices.size();
+
+        struct Cluster {
+            unsigned int start, end;
+            float facing;
+        };
+        std::vector<Cluster> order;
+        for (size_t c = 0; c + 1 < merged.size(); c++)
+        {
+            glm::vec3 center(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (unsigned int t = merged[c]; t < merged[c + 1]; t++)
+            {
+                const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &d = vertices[indices[t * 3 + 2]].Position;
+                // cross product length is twice the area, the factor cancels out
+                glm::vec3 weighted = glm::cross(b - a, d - a);
+                float weight = glm::length(weighted);
+                center += (a + b + d) * (weight / 3.0f);
+                normal += weighted;
+                area += weight;
+            }
+            Cluster cluster = {merged[c], merged[c + 1], 0.0f};
+            float normalLength = glm::length(normal);
+            if (area > 0.0f && normalLength > 0.0f)
+                cluster.facing = glm::dot(center / area - meshCenter, normal / normalLength);
+            order.push_back(cluster);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [](const Cluster &a, const Cluster &b) { return a.facing > b.facing; });
+
+        std::vector<unsigned int> sorted;
+        sorted.reserve(indices.size());
+        for (const Cluster &cluster : order)
+            sorted.insert(sorted.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+        return sorted;
+    }
+
+    static void reorderVertices(MeshData &mesh)
+    {
+        const unsigned int UNUSED = 0xFFFFFFFFu;
+        std::vector<unsigned int> remap(mesh.vertices.size(), UNUSED);
+        std::vector<Vertex> vertices;
+        vertices.reserve(mesh.vertices.size());
+        for (unsigned int &index : mesh.indices)
+        {
+            if (remap[index] == UNUSED)
+            {
+                remap[index] = (unsigned int)vertices.size();
+                vertices.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices.swap(vertices);
+    }
+};
+#endif
@@ -0,0 +1,360 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Builds the coarser levels of detail of a mesh with quadric error metrics (Garland, Heckbert 1997). Edges are
+// collapsed onto one of their end points, so every level is just another index list over the vertices of the
+// full mesh and the vertex buffer is shared. Vertices on attribute seams (same position, different normal or
+// UV) and on non-manifold edges never move, border vertices only slide along the border, and collapses that
+// would flip a triangle are rejected. Each level halves the triangle count of the one before until the error
+// would exceed MAX_ERROR times the mesh radius or a level gains too little to be worth storing.
+class MeshSimplifier
+{
+public:
+    static const unsigned int MAX_LEVELS = 3;
+
+    static void BuildLods(MeshData &mesh)
+    {
+        mesh.lods.clear();
+        if (mesh.indices.size() < 3 * MIN_TRIANGLES || mesh.indices.size() % 3 != 0)
+            return;
+
+        MeshSimplifier simplifier(mesh);
+        std::vector<unsigned int> indices = mesh.indices;
+        size_t previous = indices.size();
+        for (unsigned int level = 1; level <= MAX_LEVELS; level++)
+        {
+            size_t target = previous / 2 / 3 * 3;
+            if (target < 3 * MIN_TRIANGLES)
+                break;
+            float error = simplifier.simplify(indices, target);
+            if ((float)indices.size() > (float)previous * MIN_REDUCTION)
+                break;
+            MeshLod lod;
+            lod.indices = indices;
+            lod.error = error;
+            MeshOptimizer::OptimizeTriangles(lod.indices, mesh.vertices.size());
+            mesh.lods.push_back(lod);
+            previous = indices.size();
+        }
+    }
+
+private:
+    // a level has to keep at most this fraction of the triangles of the one before
+    static constexpr float MIN_REDUCTION = 0.8f;
+    // largest error of any level, relative to the radius of the mesh
+    static constexpr float MAX_ERROR = 0.05f;
+    static const unsigned int MIN_TRIANGLES = 32;
+    // a collapse may turn no triangle further than this, so many small turns can't add up to a flip
+    static constexpr double MIN_NORMAL_COSINE = 0.5;
+    // the border planes outweigh the surface so outlines keep their shape
+    static constexpr double BORDER_WEIGHT = 10.0;
+
+    enum Kind { INTERIOR, BORDER, LOCKED };
+
+    // symmetric 4x4 matrix of a sum of squared plane distances, plus the area the planes were weighted with
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+        double weight = 0;
+
+        void AddPlane(const glm::dvec3 &n, double d, double w)
+        {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+            a22 += w * n.z * n.z; a23 += w * n.z * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+
+        void Add(const Quadric &q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03; a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23; a33 += q.a33;
+            weight += q.weight;
+        }
+
+        // mean squared distance of p to the planes
+        double Error(const glm::dvec3 &p) const
+        {
+            double e = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x +
+                       a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y +
+                       a22 * p.z * p.z + 2 * a23 * p.z + a33;
+            return weight > 0 ? std::fabs(e) / weight : 0.0;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from, to;
+        double cost;
+    };
+
+    const std::vector<Vertex> &vertices;
+    std::vector<Kind> kinds;
+    std::vector<Quadric> quadrics;
+    // collapses are limited to this squared distance
+    double maxCost;
+    double reachedCost = 0.0;
+
+    explicit MeshSimplifier(const MeshData &mesh) : vertices(mesh.vertices), kinds(mesh.vertices.size(), INTERIOR),
+                                                    quadrics(mesh.vertices.size())
+    {
+        BoundingVolume bounds;
+        for (const Vertex &vertex : vertices)
+            bounds.Extend(vertex.Position);
+        bounds.Finish();
+        maxCost = (double)bounds.radius * MAX_ERROR * bounds.radius * MAX_ERROR;
+
+        classify(mesh.indices);
+        for (size_t t = 0; t < mesh.indices.size(); t += 3)
+        {
+            unsigned int corners[3] = {mesh.indices[t], mesh.indices[t + 1], mesh.indices[t + 2]};
+            glm::dvec3 p0 = position(corners[0]), p1 = position(corners[1]), p2 = position(corners[2]);
+            glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            double area = glm::length(normal);
+            if (area <= 0.0)
+                continue;
+            normal /= area;
+            for (unsigned int corner : corners)
+                quadrics[corner].AddPlane(normal, -glm::dot(normal, p0), area * 0.5);
+        }
+        addBorderPlanes(mesh.indices);
+    }
+
+    glm::dvec3 position(unsigned int v) const
+    {
+        return glm::dvec3(vertices[v].Position);
+    }
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    // seams and non-manifold edges lock their vertices, edges of a single triangle make border vertices
+    void classify(const std::vector<unsigned int> &indices)
+    {
+        struct PositionHash {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+        struct PositionEqual {
+            bool operator()(const glm::vec3 &a, const glm::vec3 &b) const
+            {
+                return a.x == b.x && a.y == b.y && a.z == b.z;
+            }
+        };
+        std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> firstAt;
+        for (unsigned int v = 0; v < vertices.size(); v++)
+        {
+            std::pair<std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual>::iterator, bool> inserted =
+                    firstAt.insert(std::make_pair(vertices[v].Position, v));
+            if (!inserted.second)
+                kinds[v] = kinds[inserted.first->second] = LOCKED;
+        }
+
+        for (const std::pair<const uint64_t, unsigned int> &edge : edgeCounts(indices))
+        {
+            unsigned int a = (unsigned int)(edge.first >> 32), b = (unsigned int)edge.first;
+            Kind kind = edge.second == 1 ? BORDER : edge.second == 2 ? INTERIOR : LOCKED;
+            if (kind > kinds[a])
+                kinds[a] = kind;
+            if (kind > kinds[b])
+                kinds[b] = kind;
+        }
+    }
+
+    static std::unordered_map<uint64_t, unsigned int> edgeCounts(const std::vector<unsigned int> &indices)
+    {
+        std::unordered_map<uint64_t, unsigned int> counts;
+        for (size_t t = 0; t < indices.size(); t += 3)
+            for (unsigned int e = 0; e < 3; e++)
+                counts[edgeKey(indices[t + e], indices[t + (e + 1) % 3])]++;
+        return counts;
+    }
+
+    // planes through every border edge, perpendicular to its triangle
+    void addBorderPlanes(const std::vector<unsigned int> &indices)
+    {
+        std::unordered_map<uint64_t, unsigned int> counts = edgeCounts(indices);
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            glm::dvec3 p0 = position(indices[t]), p1 = position(indices[t + 1]), p2 = position(indices[t + 2]);
+            glm::dvec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            if (glm::length(faceNormal) <= 0.0)
+                continue;
+            for (unsigned int e = 0; e < 3; e++)
+            {
+                unsigned int a = indices[t + e], b = indices[t + (e + 1) % 3];
+                if (counts[edgeKey(a, b)] != 1)
+                    continue;
+                glm::dvec3 edge = position(b) - position(a);
+                glm::dvec3 normal = glm::cross(edge, faceNormal);
+                double length = glm::length(normal);
+                if (length <= 0.0)
+                    continue;
+                normal /= length;
+                double weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+                quadrics[a].AddPlane(normal, -glm::dot(normal, position(a)), weight);
+                quadrics[b].AddPlane(normal, -glm::dot(normal, position(a)), weight);
+            }
+        }
+    }
+
+    // collapses edges of indices in passes until it has at most target indices or nothing is cheap enough;
+    // returns the largest error, as a distance, of all collapses so far
+    float simplify(std::vector<unsigned int> &indices, size_t target)
+    {
+        std::vector<unsigned int> adjacencyStart, adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<bool> touched(vertices.size());
+        std::vector<unsigned int> remap(vertices.size());
+
+        while (indices.size() > target)
+        {
+            buildAdjacency(indices, vertices.size(), adjacencyStart, adjacency);
+            std::unordered_map<uint64_t, unsigned int> counts = edgeCounts(indices);
+
+            // the cheapest allowed collapse of every vertex
+            collapses.clear();
+            for (unsigned int v = 0; v < vertices.size(); v++)
+            {
+                if (kinds[v] == LOCKED || adjacencyStart[v] == adjacencyStart[v + 1])
+                    continue;
+                Collapse best = {v, v, maxCost};
+                for (unsigned int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++)
+                {
+                    size_t t = adjacency[a] * 3;
+                    for (unsigned int corner = 0; corner < 3; corner++)
+                    {
+                        unsigned int to = indices[t + corner];
+                        if (to == v || (kinds[v] == BORDER && counts[edgeKey(v, to)] != 1))
+                            continue;
+                        Quadric combined = quadrics[v];
+                        combined.Add(quadrics[to]);
+                        double cost = combined.Error(position(to));
+                        if (cost <= best.cost)
+                        {
+                            best.to = to;
+                            best.cost = cost;
+                        }
+                    }
+                }
+                if (best.to != v)
+                    collapses.push_back(best);
+            }
+            if (collapses.empty())
+                break;
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+            // apply the cheapest ones whose neighbourhoods don't overlap, until the target is reached
+            std::fill(touched.begin(), touched.end(), false);
+            for (unsigned int v = 0; v < remap.size(); v++)
+                remap[v] = v;
+            size_t removed = 0;
+            unsigned int applied = 0;
+            for (const Collapse &collapse : collapses)
+            {
+                if (indices.size() - removed <= target)
+                    break;
+                if (touched[collapse.from] || touched[collapse.to] ||
+                    !neighbourhoodFree(collapse.from, indices, adjacencyStart, adjacency, touched) ||
+                    flips(collapse, indices, adjacencyStart, adjacency))
+                    continue;
+
+                for (unsigned int a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1]; a++)
+                {
+                    size_t t = adjacency[a] * 3;
+                    for (unsigned int corner = 0; corner < 3; corner++)
+                        touched[indices[t + corner]] = true;
+                    if (indices[t] == collapse.to || indices[t + 1] == collapse.to || indices[t + 2] == collapse.to)
+                        removed += 3;
+                }
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to].Add(quadrics[collapse.from]);
+                reachedCost = std::max(reachedCost, collapse.cost);
+                applied++;
+            }
+            if (applied == 0)
+                break;
+
+            // rewrite the triangles and drop the ones that collapsed
+            size_t write = 0;
+            for (size_t t = 0; t < indices.size(); t += 3)
+            {
+                unsigned int a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+                if (a == b || b == c || a == c)
+                    continue;
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+            indices.resize(write);
+        }
+        return (float)std::sqrt(reachedCost);
+    }
+
+    // triangles around every vertex, as offsets into one array
+    static void buildAdjacency(const std::vector<unsigned int> &indices, size_t vertexCount, std::vector<unsigned int> &start,
+                               std::vector<unsigned int> &adjacency)
+    {
+        start.assign(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+            start[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            start[v + 1] += start[v];
+        adjacency.resize(indices.size());
+        std::vector<unsigned int> filled(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[filled[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    // no vertex around from was changed by an earlier collapse of this pass
+    static bool neighbourhoodFree(unsigned int from, const std::vector<unsigned int> &indices,
+                                  const std::vector<unsigned int> &start, const std::vector<unsigned int> &adjacency,
+                                  const std::vector<bool> &touched)
+    {
+        for (unsigned int a = start[from]; a < start[from + 1]; a++)
+            for (unsigned int corner = 0; corner < 3; corner++)
+                if (touched[indices[adjacency[a] * 3 + corner]])
+                    return false;
+        return true;
+    }
+
+    // would moving from onto to turn any of the remaining triangles around from too far
+    bool flips(const Collapse &collapse, const std::vector<unsigned int> &indices, const std::vector<unsigned int> &start,
+               const std::vector<unsigned int> &adjacency) const
+    {
+        for (unsigned int a = start[collapse.from]; a < start[collapse.from + 1]; a++)
+        {
+            size_t t = adjacency[a] * 3;
+            unsigned int corners[3] = {indices[t], indices[t + 1], indices[t + 2]};
+            if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+                continue;
+            glm::dvec3 before = glm::cross(position(corners[1]) - position(corners[0]), position(corners[2]) - position(corners[0]));
+            for (unsigned int &corner : corners)
+                if (corner == collapse.from)
+                    corner = collapse.to;
+            glm::dvec3 after = glm::cross(position(corners[1]) - position(corners[0]), position(corners[2]) - position(corners[0]));
+            if (glm::dot(before, after) <= MIN_NORMAL_COSINE * glm::length(before) * glm::length(after))
+                return true;
+        }
+        return false;
+    }
+};
+#endif
@@ -10,8 +10,15 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/level_of_detail.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/texture_cache.h>
 
 #include <string>
 #include <fstream>
@@ -19,9 +26,19 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// everything a Model needs that can be produced without a GL context
+struct ModelData {
+    string path;
+    string directory;
+    vector<MeshData> meshes;
+    // material images keyed by the path written in the material, filled by ModelLoader: inspected always,
+    // decoded only when no TextureCache streams them in
+    map<string, ImageData> images;
+};
+
 
 
 
@@ -29,15 +46,52 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once. with a TextureCache one entry per reference taken
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // union of the bounds of all meshes, in model space
+    BoundingVolume bounds;
+    // vertex cache behaviour of all meshes before and after MeshOptimizer
+    VertexCacheStats cacheStats;
+    // error of every level of detail from 1 on, the largest of any mesh, for picking one level for all meshes
+    vector<float> lodErrors;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // with a cache the textures are shared with every other model that uses the same images
+    Model(string const &path, TextureCache *textureCache = nullptr, bool gamma = false) : gammaCorrection(gamma), textureCache(textureCache)
+    {
+        ModelData data;
+        if (LoadModelData(path, data))
+            createMeshes(data);
+    }
+
+    // constructor for data prepared by LoadModelData, only the GL upload happens here
+    explicit Model(ModelData &data, TextureCache *textureCache = nullptr, bool gamma = false) : gammaCorrection(gamma), textureCache(textureCache)
+    {
+        createMeshes(data);
+    }
+
+    // CPU half of loading: fills the meshes of data from the binary mesh cache, or with ASSIMP if the cache is
+    // missing or stale, in which case the imported meshes are optimized and get their levels of detail before
+    // they are cached. Touches no GL state so it can run on any thread.
+    static bool LoadModelData(string const &path, ModelData &data)
     {
-        loadModel(path);
+        data.path = path;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        if (MeshCache::Load(path, data.meshes))
+            return true;
+        if (!importModel(path, data.meshes))
+            return false;
+        for (MeshData &mesh : data.meshes)
+        {
+            MeshOptimizer::Optimize(mesh);
+            MeshSimplifier::BuildLods(mesh);
+        }
+        MeshCache::Save(path, data.meshes);
+        return true;
     }
 
     // draws the model, and thus all its meshes
@@ -47,33 +101,114 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // queues the meshes that transform puts inside the frustum, each at the level of detail lods picks for it and
+    // with the cheapest variant of shaders its material allows
+    void Submit(RenderQueue &queue, ShaderVariants &shaders, const glm::mat4 &transform, const Frustum &frustum,
+                const LodSelector &lods, CullStats &stats, bool doubleSided = false)
+    {
+        for (Mesh &mesh : meshes)
+        {
+            if (!frustum.Visible(mesh.bounds, transform))
+            {
+                stats.culled++;
+                continue;
+            }
+            int level = lods.Select(mesh.lodErrors, mesh.bounds, transform);
+            if (level < 0)
+            {
+                stats.fogged++;
+                continue;
+            }
+            queue.Submit(shaders.Get(mesh.features), mesh, transform, doubleSided, (unsigned int)level);
+            stats.Drawn(level);
+        }
+    }
+
+    // queues every mesh once for count instance matrices of the queue starting at first, see RenderQueue::AddInstances
+    void SubmitInstanced(RenderQueue &queue, ShaderVariants &shaders, unsigned int first, unsigned int count,
+                         bool doubleSided = false, unsigned int lod = 0)
+    {
+        for (Mesh &mesh : meshes)
+            queue.SubmitInstanced(shaders.Get(mesh.features), mesh, first, count, doubleSided, lod);
+    }
+
+    // gives the textures back to the cache, or deletes them if the model owns them
+    void ReleaseTextures()
+    {
+        for (const Texture &texture : textures_loaded)
+        {
+            if (textureCache)
+                textureCache->Release(texture.id);
+            else
+                glDeleteTextures(1, &texture.id);
+        }
+        textures_loaded.clear();
+    }
+
+    // GPU memory of the distinct textures of this model, textures shared with other models included
+    size_t TextureMemory() const
+    {
+        vector<unsigned int> ids;
+        for (const Texture &texture : textures_loaded)
+            ids.push_back(texture.id);
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        size_t bytes = 0;
+        for (unsigned int id : ids)
+            bytes += TextureCompressor::TextureBytes(id);
+        return bytes;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
+            mesh.ResetSamplerHandles();
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    TextureCache *textureCache;
+
+    // GL half of loading: uploads the meshes and turns their texture references into textures
+    void createMeshes(ModelData &data)
+    {
+        directory = data.directory;
+        meshes.reserve(data.meshes.size());
+        for (MeshData &meshData : data.meshes)
+        {
+            cacheStats.Add(meshData.cacheStats);
+            meshes.push_back(createMesh(meshData, data.images));
+            bounds.Extend(meshes.back().bounds);
+            // meshes with fewer levels draw their coarsest one for the levels they lack
+            const vector<float> &errors = meshes.back().lodErrors;
+            if (errors.size() > lodErrors.size())
+                lodErrors.resize(errors.size(), lodErrors.empty() ? 0.0f : lodErrors.back());
+            for (size_t level = 0; level < lodErrors.size(); level++)
+                if (!errors.empty())
+                    lodErrors[level] = std::max(lodErrors[level], errors[std::min(level, errors.size() - 1)]);
+        }
+        bounds.Finish();
+        data.meshes.clear();
+    }
+
+    // reads the file via ASSIMP and extracts the CPU side of every mesh
+    static bool importModel(string const &path, vector<MeshData> &meshData)
     {
-        // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, meshData);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshData)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,22 +216,23 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshData.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshData);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<TextureRef> &textures = data.textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -164,96 +300,111 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // appends the references to all material textures of a given type
+    static void collectMaterialTextures(aiMaterial *mat, aiTextureType type, const string &typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            TextureRef texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
-        return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // uploads the mesh data and resolves its texture references into GL textures
+    Mesh createMesh(MeshData &data, map<string, ImageData> &images)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        // before the upload, which frees the decoded images
+        unsigned int features = materialFeatures(data.textures, images);
+        vector<Texture> textures;
+        for (const TextureRef &ref : data.textures)
+            textures.push_back(loadMaterialTexture(ref, images));
+        // return a mesh object created from the extracted mesh data
+        Mesh mesh(data.vertices, data.indices, textures, data.lods);
+        mesh.features = features;
+        // the GPU has its copy now
+        vector<Vertex>().swap(data.vertices);
+        vector<unsigned int>().swap(data.indices);
+        vector<MeshLod>().swap(data.lods);
+        return mesh;
     }
-    else
+
+    // the shader features the material needs: the alpha test only if the diffuse image has an alpha channel, any
+    // other image samples as opaque; the specular term only with a specular map
+    unsigned int materialFeatures(const vector<TextureRef> &refs, const map<string, ImageData> &images) const
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        unsigned int features = 0;
+        bool diffuseSeen = false;
+        for (const TextureRef &ref : refs)
+        {
+            if (ref.type == "texture_specular")
+                features |= ShaderVariants::SPECULAR_MAP;
+            // only texture_diffuse1 is sampled
+            if (ref.type != "texture_diffuse" || diffuseSeen)
+                continue;
+            diffuseSeen = true;
+            int width, height, components = 0;
+            map<string, ImageData>::const_iterator image = images.find(ref.path);
+            if (image != images.end() && image->second.components > 0)
+                components = image->second.components;
+            else
+                stbi_info((this->directory + '/' + ref.path).c_str(), &width, &height, &components);
+            if (components == 4)
+                features |= ShaderVariants::ALPHA_TEST;
+        }
+        return features;
     }
 
-    return textureID;
-}
+    // loads the texture if it's not loaded yet. the required info is returned as a Texture struct.
+    // images decoded ahead of time are uploaded from memory, anything else is read from disk here.
+    Texture loadMaterialTexture(const TextureRef &ref, map<string, ImageData> &images)
+    {
+        map<string, ImageData>::iterator image = images.find(ref.path);
+        if (textureCache)
+        {
+            Texture texture;
+            texture.id = textureCache->Acquire(ref.path, this->directory, image != images.end() ? &image->second : nullptr,
+                                              ref.type == "texture_normal");
+            texture.type = ref.type;
+            texture.path = ref.path;
+            textures_loaded.push_back(texture);
+            return texture;
+        }
+
+        // check if texture was loaded before and if so, skip loading a new texture
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if(std::strcmp(textures_loaded[j].path.data(), ref.path.c_str()) == 0)
+            {
+                Texture texture = textures_loaded[j];
+                texture.type = ref.type;
+                return texture; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
+            }
+        }
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        if (image != images.end())
+            texture.id = TextureFromImage(image->second, ref.path.c_str());
+        else
+            texture.id = TextureFromFile(ref.path.c_str(), this->directory);
+        texture.type = ref.type;
+        texture.path = ref.path;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
+    }
+};
 #endif
@@ -0,0 +1,166 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <learnopengl/model.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <iostream>
+
+// Loads a batch of models concurrently. Parsing (mesh cache or ASSIMP) and image decoding run as tasks on a pool
+// of worker threads; every model whose CPU half is done is handed back to the calling thread, which owns the GL
+// context and does the upload while the workers keep going on the rest. With a TextureStreamer the images are
+// not decoded here, only hashed and their headers read, and the textures stream in afterwards.
+// Textures go through the TextureCache, if one is passed, so models share identical images.
+class ModelLoader
+{
+public:
+    // loads all paths and returns the models in the same order. threadCount 0 uses one worker per hardware thread.
+    static vector<Model> LoadAll(const vector<string> &paths, TextureCache *textureCache = nullptr, unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        ModelLoader loader(paths.size());
+        loader.decodeImages = textureCache == nullptr || !textureCache->Streaming();
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            loader.jobs[i].data.path = paths[i];
+            loader.push([&loader, i]() { loader.parse(i); });
+        }
+
+        vector<std::thread> workers;
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([&loader]() { loader.work(); });
+
+        // GL upload in completion order, on this thread
+        vector<unique_ptr<Model>> loaded(paths.size());
+        for (size_t uploaded = 0; uploaded < paths.size(); uploaded++)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(loader.mutex);
+                loader.readyChanged.wait(lock, [&loader]() { return !loader.ready.empty(); });
+                index = loader.ready.front();
+                loader.ready.pop_front();
+            }
+            loaded[index].reset(new Model(loader.jobs[index].data, textureCache));
+        }
+
+        for (std::thread &worker : workers)
+            worker.join();
+
+        vector<Model> models;
+        models.reserve(paths.size());
+        for (unique_ptr<Model> &model : loaded)
+            models.push_back(std::move(*model));
+        return models;
+    }
+
+private:
+    struct Job {
+        ModelData data;
+        // image decode tasks of this model that have not finished yet
+        size_t pendingImages = 0;
+    };
+
+    vector<Job> jobs;
+    bool decodeImages = true;
+    std::deque<std::function<void()>> tasks;
+    // tasks queued or running, the workers stop once it drops to zero
+    size_t outstanding = 0;
+    std::deque<size_t> ready;
+    std::mutex mutex;
+    std::condition_variable tasksChanged;
+    std::condition_variable readyChanged;
+
+    explicit ModelLoader(size_t count) : jobs(count) {}
+
+    void push(std::function<void()> task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        outstanding++;
+        tasksChanged.notify_one();
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                tasksChanged.wait(lock, [this]() { return !tasks.empty() || outstanding == 0; });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--outstanding == 0)
+                    tasksChanged.notify_all();
+            }
+        }
+    }
+
+    // parses the model, then fans out one task per distinct texture that decodes it, unless it streams, and
+    // inspects it for the TextureCache
+    void parse(size_t index)
+    {
+        Job &job = jobs[index];
+        if (!Model::LoadModelData(job.data.path, job.data))
+        {
+            markReady(index);
+            return;
+        }
+
+        // the map is completely built before any decode task runs, every task only writes its own entry
+        for (const MeshData &mesh : job.data.meshes)
+            for (const TextureRef &texture : mesh.textures)
+                job.data.images[texture.path];
+        if (job.data.images.empty())
+        {
+            markReady(index);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job.pendingImages = job.data.images.size();
+        }
+        for (auto &entry : job.data.images)
+        {
+            const string *path = &entry.first;
+            ImageData *image = &entry.second;
+            push([this, index, path, image]() {
+                if (decodeImages)
+                    *image = DecodeImage(path->c_str(), jobs[index].data.directory);
+                TextureCache::Inspect(*image, *path, jobs[index].data.directory);
+                bool done;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done = --jobs[index].pendingImages == 0;
+                }
+                if (done)
+                    markReady(index);
+            });
+        }
+    }
+
+    void markReady(size_t index)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(index);
+        readyChanged.notify_one();
+    }
+};
+#endif
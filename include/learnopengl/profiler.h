@@ -0,0 +1,236 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <chrono>
+#include <algorithm>
+
+// Frame profiler with nested named scopes. Every scope measures CPU time directly and GPU time with a pair of
+// GL_TIMESTAMP queries; GL_TIME_ELAPSED can't be used because only one of those may be active at a time, so
+// nested scopes would be impossible. Queries of a frame are read FRAMES_IN_FLIGHT frames later, and only if the
+// GPU has finished them, so reading results never stalls the pipeline.
+class Profiler
+{
+public:
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+    // samples kept per scope for min/avg/max
+    static const unsigned int HISTORY = 120;
+
+    struct Samples {
+        float values[HISTORY];
+        unsigned int count = 0;
+        unsigned int next = 0;
+
+        void Add(float value)
+        {
+            values[next] = value;
+            next = (next + 1) % HISTORY;
+            if (count < HISTORY)
+                count++;
+        }
+
+        void Summary(float &minimum, float &average, float &maximum) const
+        {
+            minimum = average = maximum = 0.0f;
+            if (count == 0)
+                return;
+            minimum = maximum = values[0];
+            float sum = 0.0f;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                minimum = std::min(minimum, values[i]);
+                maximum = std::max(maximum, values[i]);
+                sum += values[i];
+            }
+            average = sum / count;
+        }
+    };
+
+    // one named scope under one parent, times in milliseconds
+    struct Stat {
+        std::string name;
+        int parent;
+        unsigned int depth;
+        Samples cpu;
+        Samples gpu;
+    };
+
+    // GPU results that were not ready in time and got dropped instead of waited for
+    unsigned int droppedFrames = 0;
+    // when set, the GPU time of every frame's "Frame" scope goes into frameTimes, indexed by frame, -1 if dropped
+    bool keepFrameTimes = false;
+    std::vector<float> frameTimes;
+
+    // stats in the order the scopes were first seen
+    const std::vector<Stat> &Stats() const
+    {
+        return stats;
+    }
+
+    // indices into Stats() with every scope directly followed by its children
+    std::vector<unsigned int> DisplayOrder() const
+    {
+        std::vector<unsigned int> order;
+        appendChildren(-1, order);
+        return order;
+    }
+
+    // collects the GPU times of the frame that used this query slot before and opens the "Frame" scope
+    void BeginFrame()
+    {
+        FrameSlot &slot = slots[frameIndex % FRAMES_IN_FLIGHT];
+        if (slot.pending)
+            resolve(slot);
+        slot.used = 0;
+        slot.records.clear();
+        slot.pending = false;
+        slot.frame = frameIndex;
+        Begin("Frame");
+    }
+
+    void EndFrame()
+    {
+        End();
+        slots[frameIndex % FRAMES_IN_FLIGHT].pending = true;
+        frameIndex++;
+    }
+
+    void Begin(const std::string &name)
+    {
+        FrameSlot &slot = slots[frameIndex % FRAMES_IN_FLIGHT];
+        int parent = open.empty() ? -1 : (int)slot.records[open.back()].stat;
+
+        Record record;
+        record.stat = findStat(parent, name);
+        record.queryBegin = nextQuery(slot);
+        record.queryEnd = nextQuery(slot);
+        record.cpuBegin = std::chrono::steady_clock::now();
+        glQueryCounter(slot.queries[record.queryBegin], GL_TIMESTAMP);
+
+        open.push_back(slot.records.size());
+        slot.records.push_back(record);
+    }
+
+    void End()
+    {
+        FrameSlot &slot = slots[frameIndex % FRAMES_IN_FLIGHT];
+        Record &record = slot.records[open.back()];
+        open.pop_back();
+        glQueryCounter(slot.queries[record.queryEnd], GL_TIMESTAMP);
+        std::chrono::duration<float, std::milli> cpu = std::chrono::steady_clock::now() - record.cpuBegin;
+        stats[record.stat].cpu.Add(cpu.count());
+    }
+
+    // waits for the GPU and reads every outstanding frame, for the end of a benchmark run
+    void Flush()
+    {
+        glFinish();
+        for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; i++)
+        {
+            FrameSlot &slot = slots[(frameIndex + i) % FRAMES_IN_FLIGHT];
+            if (slot.pending)
+                resolve(slot);
+            slot.pending = false;
+        }
+    }
+
+    void Release()
+    {
+        for (FrameSlot &slot : slots)
+        {
+            if (!slot.queries.empty())
+                glDeleteQueries((GLsizei)slot.queries.size(), &slot.queries[0]);
+            slot.queries.clear();
+        }
+    }
+
+private:
+    struct Record {
+        unsigned int stat;
+        unsigned int queryBegin;
+        unsigned int queryEnd;
+        std::chrono::steady_clock::time_point cpuBegin;
+    };
+
+    struct FrameSlot {
+        std::vector<unsigned int> queries;
+        unsigned int used = 0;
+        std::vector<Record> records;
+        bool pending = false;
+        unsigned int frame = 0;
+    };
+
+    FrameSlot slots[FRAMES_IN_FLIGHT];
+    unsigned int frameIndex = 0;
+    // records of the scopes that are open right now
+    std::vector<size_t> open;
+    std::vector<Stat> stats;
+    std::map<std::pair<int, std::string>, unsigned int> statIndices;
+
+    unsigned int findStat(int parent, const std::string &name)
+    {
+        std::pair<int, std::string> key(parent, name);
+        std::map<std::pair<int, std::string>, unsigned int>::iterator found = statIndices.find(key);
+        if (found != statIndices.end())
+            return found->second;
+
+        Stat stat;
+        stat.name = name;
+        stat.parent = parent;
+        stat.depth = parent < 0 ? 0 : stats[parent].depth + 1;
+        stats.push_back(stat);
+        statIndices[key] = (unsigned int)(stats.size() - 1);
+        return (unsigned int)(stats.size() - 1);
+    }
+
+    void appendChildren(int parent, std::vector<unsigned int> &order) const
+    {
+        for (unsigned int i = 0; i < stats.size(); i++)
+        {
+            if (stats[i].parent != parent)
+                continue;
+            order.push_back(i);
+            appendChildren((int)i, order);
+        }
+    }
+
+    unsigned int nextQuery(FrameSlot &slot)
+    {
+        if (slot.used == slot.queries.size())
+        {
+            slot.queries.push_back(0);
+            glGenQueries(1, &slot.queries.back());
+        }
+        return slot.used++;
+    }
+
+    void resolve(FrameSlot &slot)
+    {
+        // queries finish in order, the end of the "Frame" scope is issued last so it decides for all of them
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[slot.records.front().queryEnd], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (keepFrameTimes && frameTimes.size() <= slot.frame)
+            frameTimes.resize(slot.frame + 1, -1.0f);
+        if (!available)
+        {
+            droppedFrames++;
+            return;
+        }
+        for (const Record &record : slot.records)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(slot.queries[record.queryBegin], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(slot.queries[record.queryEnd], GL_QUERY_RESULT, &end);
+            float milliseconds = (float)(end - begin) / 1000000.0f;
+            stats[record.stat].gpu.Add(milliseconds);
+            if (keepFrameTimes && &record == &slot.records.front())
+                frameTimes[slot.frame] = milliseconds;
+        }
+    }
+};
+#endif
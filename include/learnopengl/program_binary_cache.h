@@ -0,0 +1,248 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include <glad/glad.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+
+// ARB_get_program_binary is core only from GL 4.1 and not part of the bundled glad
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_FORMATS
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+const uint32_t PROGRAM_BINARY_CACHE_VERSION = 1;
+// far above any program of the series, binaries claiming more are treated as damaged
+const uint32_t PROGRAM_BINARY_MAX_LENGTH = 64u << 20;
+
+struct ProgramBinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+// Linked programs as the driver hands them out with glGetProgramBinary, one file per program in a cache directory,
+// named after a hash of the program's sources and of the vendor, renderer and version strings of the driver.
+// A binary the driver no longer takes, after an update for example, fails glProgramBinary and the program is
+// compiled from source again, which also replaces the stale file.
+class ProgramBinaryCache
+{
+public:
+    // how the programs of this run were made, and the time spent on it
+    struct Stats {
+        unsigned int loaded = 0;
+        unsigned int compiled = 0;
+        // binaries the driver turned down or that were damaged
+        unsigned int rejected = 0;
+        double seconds = 0.0;
+    };
+
+    // looks up the entry points and the binary formats; until this ran, or without driver support, every program is
+    // compiled from source
+    static void Init(GLADloadproc load, const std::string &directory = "resources/shader_cache")
+    {
+        State &s = state();
+        s.directory = directory;
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major < 4 || (major == 4 && minor < 1))
+        {
+            if (!hasExtension("GL_ARB_get_program_binary"))
+                return;
+        }
+        s.getProgramBinary = (GetProgramBinaryProc) load("glGetProgramBinary");
+        s.programBinary = (ProgramBinaryProc) load("glProgramBinary");
+        s.programParameteri = (ProgramParameteriProc) load("glProgramParameteri");
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        s.formats.resize(formatCount);
+        if (formatCount > 0)
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, s.formats.data());
+
+        s.driver = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+        s.enabled = s.getProgramBinary && s.programBinary && formatCount > 0;
+        if (s.enabled)
+            mkdir(directory.c_str(), 0755);
+    }
+
+    static bool Enabled()
+    {
+        return state().enabled;
+    }
+
+    static Stats &Statistics()
+    {
+        return state().stats;
+    }
+
+    // 64-bit FNV-1a of the sources and the driver strings
+    static uint64_t Key(const std::string &sources)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : sources)
+            hash = (hash ^ c) * 1099511628211ULL;
+        for (unsigned char c : state().driver)
+            hash = (hash ^ c) * 1099511628211ULL;
+        return hash;
+    }
+
+    // links program from the cached binary for key, returns false if there is none or the driver rejects it
+    static bool Load(GLuint program, uint64_t key)
+    {
+        State &s = state();
+        if (!s.enabled)
+            return false;
+        std::ifstream in(path(key), std::ios::binary);
+        ProgramBinaryHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return false;
+        if (std::memcmp(header.magic, "PROGBIN", 8) != 0 || header.version != PROGRAM_BINARY_CACHE_VERSION ||
+            header.key != key)
+            return false;
+        // a format this driver doesn't list would only raise GL_INVALID_ENUM
+        if (std::find(s.formats.begin(), s.formats.end(), (GLint)header.format) == s.formats.end())
+        {
+            s.stats.rejected++;
+            return false;
+        }
+        // the length comes from the file, a truncated or damaged one must not make us allocate whatever it says
+        std::streampos start = in.tellg();
+        in.seekg(0, std::ios::end);
+        std::streamoff remaining = in.tellg() - start;
+        if (header.length == 0 || header.length > PROGRAM_BINARY_MAX_LENGTH ||
+            (std::streamoff)header.length > remaining)
+        {
+            s.stats.rejected++;
+            return false;
+        }
+        in.seekg(start);
+        std::vector<char> binary(header.length);
+        if (!in.read(binary.data(), binary.size()))
+            return false;
+
+        s.programBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            s.stats.rejected++;
+            return false;
+        }
+        return true;
+    }
+
+    // asks the driver to keep the binary of program around, call before glLinkProgram
+    static void PrepareLink(GLuint program)
+    {
+        State &s = state();
+        if (s.enabled && s.programParameteri)
+            s.programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // writes the binary of the linked program, through a temporary file like the mesh cache
+    static void Save(GLuint program, uint64_t key)
+    {
+        State &s = state();
+        if (!s.enabled)
+            return;
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!linked || length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        s.getProgramBinary(program, length, &length, &format, binary.data());
+
+        ProgramBinaryHeader header;
+        std::memcpy(header.magic, "PROGBIN", 8);
+        header.version = PROGRAM_BINARY_CACHE_VERSION;
+        header.format = format;
+        header.key = key;
+        header.length = (uint32_t)length;
+        header.reserved = 0;
+        std::string cachePath = path(key);
+        std::string temporaryPath = cachePath + ".tmp";
+        std::ofstream out(temporaryPath, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(binary.data(), length);
+        out.close();
+        if (!out || std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::cout << "PROGRAM_BINARY_CACHE:: failed to write " << cachePath << std::endl;
+            std::remove(temporaryPath.c_str());
+        }
+    }
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                                  GLenum *binaryFormat, void *binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary,
+                                               GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    struct State {
+        bool enabled = false;
+        std::string directory;
+        std::string driver;
+        std::vector<GLint> formats;
+        GetProgramBinaryProc getProgramBinary = nullptr;
+        ProgramBinaryProc programBinary = nullptr;
+        ProgramParameteriProc programParameteri = nullptr;
+        Stats stats;
+    };
+
+    static State &state()
+    {
+        static State s;
+        return s;
+    }
+
+    static std::string path(uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.progbin", (unsigned long long)key);
+        return state().directory + '/' + name;
+    }
+
+    static std::string glString(GLenum name)
+    {
+        const GLubyte *value = glGetString(name);
+        return value ? std::string(reinterpret_cast<const char *>(value)) : std::string();
+    }
+
+    static bool hasExtension(const char *name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const GLubyte *extension = glGetStringi(GL_EXTENSIONS, (GLuint)i);
+            if (extension && std::strcmp(reinterpret_cast<const char *>(extension), name) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+#endif
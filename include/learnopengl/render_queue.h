@@ -0,0 +1,213 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// one mesh draw, either with its own model matrix or for a range of the queue's instance matrices
+struct DrawPacket {
+    uint64_t key;
+    Mesh *mesh;
+    Shader *shader;
+    glm::mat4 transform;
+    unsigned int firstInstance;
+    // 0 for a plain draw with transform
+    unsigned int instanceCount;
+    bool doubleSided;
+    // level of detail, see Mesh::Lod
+    unsigned int lod;
+};
+
+// Collects the draws of a frame and issues them sorted by a 64-bit key, so draws that share state end up next
+// to each other and the state tracker can drop the binds they have in common. From the most to the least
+// significant bits the key holds the cull state (two-sided draws last), the program, the texture set and the
+// VAO; equal keys keep their submission order. The instance matrices of all instanced packets share one buffer
+// that is uploaded once per flush.
+class RenderQueue
+{
+public:
+    // draw calls of the last flush
+    unsigned int packetsDrawn = 0;
+
+    void Submit(Shader &shader, Mesh &mesh, const glm::mat4 &transform, bool doubleSided, unsigned int lod = 0)
+    {
+        DrawPacket packet = {makeKey(shader, mesh, doubleSided), &mesh, &shader, transform, 0, 0, doubleSided, lod};
+        packets.push_back(packet);
+    }
+
+    // copies transforms into the frame's instance buffer and returns the index of the first one
+    unsigned int AddInstances(const std::vector<glm::mat4> &transforms)
+    {
+        unsigned int first = (unsigned int)instances.size();
+        instances.insert(instances.end(), transforms.begin(), transforms.end());
+        return first;
+    }
+
+    // draws count instances starting at first, as returned by AddInstances
+    void SubmitInstanced(Shader &shader, Mesh &mesh, unsigned int first, unsigned int count, bool doubleSided,
+                         unsigned int lod = 0)
+    {
+        if (count == 0)
+            return;
+        DrawPacket packet = {makeKey(shader, mesh, doubleSided), &mesh, &shader, glm::mat4(1.0f), first, count, doubleSided,
+                             lod};
+        packets.push_back(packet);
+    }
+
+    // issues everything submitted since the last flush; the tracker is invalidated first since other code may
+    // have changed GL state in between. Leaves back face culling enabled.
+    void Flush(GLStateTracker &state)
+    {
+        state.Invalidate();
+        packetsDrawn = (unsigned int)packets.size();
+        if (!instances.empty())
+            uploadInstances();
+
+        order.clear();
+        for (unsigned int i = 0; i < packets.size(); i++)
+            order.push_back(std::make_pair(packets[i].key, i));
+        std::sort(order.begin(), order.end());
+
+        for (const std::pair<uint64_t, unsigned int> &entry : order)
+            issue(state, packets[entry.second]);
+
+        state.SetCullFace(true);
+        state.BindVertexArray(0);
+        packets.clear();
+        instances.clear();
+    }
+
+    void Release()
+    {
+        if (instanceVBO)
+            glDeleteBuffers(1, &instanceVBO);
+        instanceVBO = 0;
+        instanceOffsets.clear();
+        instancedArrays.clear();
+    }
+
+private:
+    struct ShaderHandles {
+        UniformHandle model;
+        UniformHandle instanced;
+        UniformHandle positionScale;
+        UniformHandle positionOffset;
+    };
+
+    std::vector<DrawPacket> packets;
+    std::vector<std::pair<uint64_t, unsigned int>> order;
+    std::vector<glm::mat4> instances;
+    unsigned int instanceVBO = 0;
+    // first instance every VAO's instance attributes point at, so they are only respecified when that changes
+    std::unordered_map<unsigned int, unsigned int> instanceOffsets;
+    // VAOs whose instance attributes are enabled; the VAOs are shared, so a plain draw has to turn them off first
+    std::unordered_set<unsigned int> instancedArrays;
+    std::unordered_map<unsigned int, ShaderHandles> shaderHandles;
+    // small ids for the texture sets seen so far, and the set of every mesh
+    std::map<std::vector<unsigned int>, unsigned int> textureSets;
+    std::unordered_map<const Mesh *, unsigned int> meshTextureSets;
+
+    uint64_t makeKey(const Shader &shader, const Mesh &mesh, bool doubleSided)
+    {
+        return ((uint64_t)(doubleSided ? 1 : 0) << 63) | ((uint64_t)(shader.ID & 0x7FFF) << 48) |
+               ((uint64_t)(textureSet(mesh) & 0xFFFFFF) << 24) | (uint64_t)(mesh.VAO & 0xFFFFFF);
+    }
+
+    unsigned int textureSet(const Mesh &mesh)
+    {
+        std::unordered_map<const Mesh *, unsigned int>::iterator found = meshTextureSets.find(&mesh);
+        if (found != meshTextureSets.end())
+            return found->second;
+        std::vector<unsigned int> ids;
+        for (const Texture &texture : mesh.textures)
+            ids.push_back(texture.id);
+        std::map<std::vector<unsigned int>, unsigned int>::iterator set = textureSets.find(ids);
+        unsigned int id = set != textureSets.end() ? set->second : (unsigned int)textureSets.size();
+        if (set == textureSets.end())
+            textureSets[ids] = id;
+        meshTextureSets[&mesh] = id;
+        return id;
+    }
+
+    const ShaderHandles &handles(const Shader &shader)
+    {
+        std::unordered_map<unsigned int, ShaderHandles>::iterator found = shaderHandles.find(shader.ID);
+        if (found != shaderHandles.end())
+            return found->second;
+        ShaderHandles resolved;
+        resolved.model = shader.uniform("model");
+        resolved.instanced = shader.uniform("instanced");
+        resolved.positionScale = shader.uniform("positionScale");
+        resolved.positionOffset = shader.uniform("positionOffset");
+        return shaderHandles[shader.ID] = resolved;
+    }
+
+    void uploadInstances()
+    {
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+        // respecifying the whole store every flush lets the driver orphan the previous contents
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::mat4), &instances[0], GL_STREAM_DRAW);
+        // the store is new, every VAO has to point into it again
+        instanceOffsets.clear();
+    }
+
+    void issue(GLStateTracker &state, const DrawPacket &packet)
+    {
+        Shader &shader = *packet.shader;
+        Mesh &mesh = *packet.mesh;
+        const GeometryRange &geometry = mesh.Lod(packet.lod);
+        const ShaderHandles &uniforms = handles(shader);
+
+        state.UseProgram(shader.ID);
+        state.SetCullFace(!packet.doubleSided);
+        const std::vector<UniformHandle> &samplers = mesh.SamplerHandles(shader);
+        for (unsigned int i = 0; i < mesh.textures.size(); i++)
+        {
+            state.SetInt(shader, samplers[i], i);
+            state.BindTexture(i, mesh.textures[i].id);
+        }
+        state.BindVertexArray(mesh.VAO);
+        state.SetVec3(shader, uniforms.positionScale, mesh.positionScale);
+        state.SetVec3(shader, uniforms.positionOffset, mesh.positionOffset);
+
+        if (packet.instanceCount == 0)
+        {
+            if (instancedArrays.erase(mesh.VAO))
+            {
+                mesh.DisableInstanceAttributes();
+                instanceOffsets.erase(mesh.VAO);
+            }
+            state.SetInt(shader, uniforms.instanced, 0);
+            shader.setMat4(uniforms.model, packet.transform);
+            glDrawElementsBaseVertex(GL_TRIANGLES, geometry.indexCount, geometry.indexType, geometry.IndexOffset(),
+                                     geometry.baseVertex);
+            return;
+        }
+
+        std::unordered_map<unsigned int, unsigned int>::iterator offset = instanceOffsets.find(mesh.VAO);
+        if (offset == instanceOffsets.end() || offset->second != packet.firstInstance)
+        {
+            mesh.SetupInstanceAttributes(instanceVBO, packet.firstInstance * sizeof(glm::mat4));
+            instanceOffsets[mesh.VAO] = packet.firstInstance;
+            instancedArrays.insert(mesh.VAO);
+        }
+        state.SetInt(shader, uniforms.instanced, 1);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, geometry.indexCount, geometry.indexType, geometry.IndexOffset(),
+                                          packet.instanceCount, geometry.baseVertex);
+    }
+};
+#endif
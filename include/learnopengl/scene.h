@@ -0,0 +1,523 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/lights.h>
+#include <learnopengl/scrolling_layers.h>
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+// a model drawn once where it is
+struct SceneObject {
+    unsigned int model;
+    glm::vec3 position;
+    // scale and rotation, applied before the translation
+    glm::mat4 transform;
+    bool doubleSided;
+};
+
+// a car that drives back and forth along x between minX and maxX
+struct SceneCar {
+    unsigned int model;
+    glm::vec3 position;
+    glm::mat4 transform;
+    float minX;
+    float maxX;
+    // starts driving towards minX
+    bool forward;
+    // z = swayAmplitude * sin(time * swayFrequency) when the amplitude isn't 0
+    float swayAmplitude;
+    float swayFrequency;
+};
+
+struct SceneLayer {
+    unsigned int model;
+    // everything but the model pointer, that one is only known once the models are loaded
+    ScrollingLayer layer;
+};
+
+// Everything resources/scenes/*.scene declares: models, what is drawn where, lights, fog and post-processing.
+// The format is one statement per line, a keyword followed by arguments and keyword-value options, with # comments;
+// see resources/scenes/default.scene. Load either fills the whole description or reports the first error and
+// leaves it untouched, so a broken edit during hot reload keeps the last good scene on screen.
+struct SceneDescription {
+    std::vector<std::string> modelNames;
+    std::vector<std::string> modelPaths;
+    std::vector<SceneObject> objects;
+    std::vector<SceneCar> cars;
+    std::vector<SceneLayer> layers;
+
+    // scroll speed of the layers, forward and backward speed of the cars
+    float speed = 7.0f;
+    float carForward = 5.0f;
+    float carBackward = 3.0f;
+
+    DirLight dirLight = {glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.5f), glm::vec3(0.4f), glm::vec3(0.5f)};
+    // the car that carries the two headlights, -1 for none; the second one mirrors the offset in z
+    int headlightCar = -1;
+    glm::vec3 headlightOffset = glm::vec3(0.0f);
+    // the layer whose copies carry the lamp lights, one per copy, -1 for none
+    int lampLayer = -1;
+    glm::vec3 lampLightOffset = glm::vec3(0.0f);
+
+    float fogDensity = 5.0f;
+    float fogStart = 30.0f;
+    float fogEnd = 100.0f;
+    glm::vec3 fogColor = glm::vec3(0.7f);
+
+    unsigned int bloomPasses = 5;
+    float exposure = 0.5f;
+
+    // multiplies the copy count of every layer, for benchmarking heavier scenes
+    float instanceScale = 1.0f;
+
+    // copies of a layer after the instance scale
+    unsigned int LayerCount(unsigned int index) const
+    {
+        float count = std::round(layers[index].layer.count * instanceScale);
+        return count < 1.0f ? 1u : (unsigned int)count;
+    }
+
+    static bool Load(const std::string &path, SceneDescription &scene)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "SCENE::FILE_NOT_FOUND: " << path << std::endl;
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string text = buffer.str();
+
+        SceneDescription parsed;
+        std::string error;
+        if (!Parse(text.c_str(), text.c_str() + text.size(), parsed, error))
+        {
+            std::cout << "SCENE::PARSE_ERROR: " << path << ":" << error << std::endl;
+            return false;
+        }
+        scene = parsed;
+        return true;
+    }
+
+    // error is "<line>: <message>" on failure
+    static bool Parse(const char *begin, const char *end, SceneDescription &scene, std::string &error);
+
+private:
+    // walks the text a token at a time without copying it; tokens never continue past the end of a line
+    struct Cursor {
+        const char *p;
+        const char *end;
+        unsigned int line;
+
+        void skipBlanks()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+                p++;
+            if (p < end && *p == '#')
+                while (p < end && *p != '\n')
+                    p++;
+        }
+
+        bool lineEnd()
+        {
+            skipBlanks();
+            return p == end || *p == '\n';
+        }
+
+        // moves to the start of the next line
+        void nextLine()
+        {
+            while (p < end && *p != '\n')
+                p++;
+            if (p < end)
+            {
+                p++;
+                line++;
+            }
+        }
+
+        bool word(std::string &value)
+        {
+            if (lineEnd())
+                return false;
+            const char *start = p;
+            while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+                p++;
+            value.assign(start, p);
+            return true;
+        }
+
+        // is the next token the given keyword; consumes it if so
+        bool keyword(const char *name)
+        {
+            if (lineEnd())
+                return false;
+            size_t length = std::strlen(name);
+            if ((size_t)(end - p) < length || std::strncmp(p, name, length) != 0)
+                return false;
+            const char *after = p + length;
+            if (after != end && *after != ' ' && *after != '\t' && *after != '\r' && *after != '\n')
+                return false;
+            p = after;
+            return true;
+        }
+
+        bool number(float &value)
+        {
+            if (lineEnd())
+                return false;
+            // strtof stops at the first character that isn't part of the number, the newline at the latest
+            char *after;
+            value = std::strtof(p, &after);
+            if (after == p)
+                return false;
+            p = after;
+            return true;
+        }
+
+        bool vec3(glm::vec3 &value)
+        {
+            return number(value.x) && number(value.y) && number(value.z);
+        }
+
+        // everything up to the end of the line without trailing blanks, for paths with spaces
+        bool rest(std::string &value)
+        {
+            if (lineEnd())
+                return false;
+            const char *start = p;
+            while (p < end && *p != '\n' && *p != '#')
+                p++;
+            const char *last = p;
+            while (last > start && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+                last--;
+            value.assign(start, last);
+            return true;
+        }
+    };
+
+    static bool fail(const Cursor &cursor, const std::string &message, std::string &error)
+    {
+        error = std::to_string(cursor.line) + ": " + message;
+        return false;
+    }
+
+    static bool modelIndex(Cursor &cursor, const SceneDescription &scene, unsigned int &index, std::string &error)
+    {
+        std::string name;
+        if (!cursor.word(name))
+            return fail(cursor, "expected a model name", error);
+        for (unsigned int i = 0; i < scene.modelNames.size(); i++)
+        {
+            if (scene.modelNames[i] == name)
+            {
+                index = i;
+                return true;
+            }
+        }
+        return fail(cursor, "unknown model " + name, error);
+    }
+
+    // scale s and rotate degrees x y z, both optional, composed in the order they appear
+    static bool transformOption(Cursor &cursor, glm::mat4 &transform, bool &matched, std::string &error)
+    {
+        matched = true;
+        if (cursor.keyword("scale"))
+        {
+            float scale;
+            if (!cursor.number(scale))
+                return fail(cursor, "scale expects a number", error);
+            transform = glm::scale(transform, glm::vec3(scale));
+        }
+        else if (cursor.keyword("rotate"))
+        {
+            float degrees;
+            glm::vec3 axis;
+            if (!cursor.number(degrees) || !cursor.vec3(axis))
+                return fail(cursor, "rotate expects degrees and an axis", error);
+            transform = glm::rotate(transform, glm::radians(degrees), axis);
+        }
+        else
+            matched = false;
+        return true;
+    }
+
+    static bool unexpected(Cursor &cursor, std::string &error)
+    {
+        std::string token;
+        cursor.word(token);
+        return fail(cursor, "unexpected " + token, error);
+    }
+};
+
+inline bool SceneDescription::Parse(const char *begin, const char *end, SceneDescription &scene, std::string &error)
+{
+    Cursor cursor = {begin, end, 1};
+    std::string statement;
+    for (; cursor.p < cursor.end; cursor.nextLine())
+    {
+        if (!cursor.word(statement))
+            continue;
+
+        if (statement == "model")
+        {
+            std::string name, path;
+            if (!cursor.word(name) || !cursor.rest(path))
+                return fail(cursor, "model expects a name and a path", error);
+            scene.modelNames.push_back(name);
+            scene.modelPaths.push_back(path);
+        }
+        else if (statement == "object")
+        {
+            SceneObject object = {0, glm::vec3(0.0f), glm::mat4(1.0f), false};
+            if (!modelIndex(cursor, scene, object.model, error))
+                return false;
+            while (!cursor.lineEnd())
+            {
+                bool matched;
+                if (!transformOption(cursor, object.transform, matched, error))
+                    return false;
+                if (matched)
+                    continue;
+                if (cursor.keyword("position"))
+                {
+                    if (!cursor.vec3(object.position))
+                        return fail(cursor, "position expects x y z", error);
+                }
+                else if (cursor.keyword("double_sided"))
+                    object.doubleSided = true;
+                else
+                    return unexpected(cursor, error);
+            }
+            scene.objects.push_back(object);
+        }
+        else if (statement == "car")
+        {
+            SceneCar car = {0, glm::vec3(0.0f), glm::mat4(1.0f), 0.0f, 0.0f, false, 0.0f, 0.0f};
+            if (!modelIndex(cursor, scene, car.model, error))
+                return false;
+            while (!cursor.lineEnd())
+            {
+                bool matched;
+                if (!transformOption(cursor, car.transform, matched, error))
+                    return false;
+                if (matched)
+                    continue;
+                if (cursor.keyword("position"))
+                {
+                    if (!cursor.vec3(car.position))
+                        return fail(cursor, "position expects x y z", error);
+                }
+                else if (cursor.keyword("range"))
+                {
+                    if (!cursor.number(car.minX) || !cursor.number(car.maxX))
+                        return fail(cursor, "range expects min and max x", error);
+                }
+                else if (cursor.keyword("sway"))
+                {
+                    if (!cursor.number(car.swayAmplitude) || !cursor.number(car.swayFrequency))
+                        return fail(cursor, "sway expects amplitude and frequency", error);
+                }
+                else if (cursor.keyword("forward"))
+                    car.forward = true;
+                else
+                    return unexpected(cursor, error);
+            }
+            scene.cars.push_back(car);
+        }
+        else if (statement == "layer")
+        {
+            SceneLayer layer;
+            if (!modelIndex(cursor, scene, layer.model, error))
+                return false;
+            float count = 1.0f;
+            bool period = false;
+            while (!cursor.lineEnd())
+            {
+                bool matched;
+                if (!transformOption(cursor, layer.layer.transform, matched, error))
+                    return false;
+                if (matched)
+                    continue;
+                if (cursor.keyword("origin"))
+                {
+                    if (!cursor.vec3(layer.layer.origin))
+                        return fail(cursor, "origin expects x y z", error);
+                }
+                else if (cursor.keyword("spacing"))
+                {
+                    if (!cursor.number(layer.layer.spacing))
+                        return fail(cursor, "spacing expects a number", error);
+                }
+                else if (cursor.keyword("count"))
+                {
+                    if (!cursor.number(count) || count < 1.0f)
+                        return fail(cursor, "count expects a positive number", error);
+                }
+                else if (cursor.keyword("period"))
+                {
+                    if (!cursor.number(layer.layer.period))
+                        return fail(cursor, "period expects a number", error);
+                    period = true;
+                }
+                else if (cursor.keyword("speed"))
+                {
+                    // layers only wrap forward, see ScrollingLayers::Advance
+                    if (!cursor.number(layer.layer.speed) || layer.layer.speed < 0.0f)
+                        return fail(cursor, "speed expects a number that is not negative", error);
+                }
+                else if (cursor.keyword("double_sided"))
+                    layer.layer.doubleSided = true;
+                else
+                    return unexpected(cursor, error);
+            }
+            layer.layer.count = (unsigned int)count;
+            // rows of evenly spaced copies loop after one spacing unless told otherwise
+            if (!period)
+                layer.layer.period = layer.layer.spacing;
+            if (layer.layer.period <= 0.0f)
+                return fail(cursor, "layer needs a positive spacing or period", error);
+            scene.layers.push_back(layer);
+        }
+        else if (statement == "speed")
+        {
+            if (!cursor.number(scene.speed) || !cursor.number(scene.carForward) || !cursor.number(scene.carBackward))
+                return fail(cursor, "speed expects the layer, car forward and car backward speeds", error);
+            if (scene.speed < 0.0f)
+                return fail(cursor, "the layer speed can't be negative", error);
+        }
+        else if (statement == "dirlight")
+        {
+            while (!cursor.lineEnd())
+            {
+                glm::vec3 *target;
+                if (cursor.keyword("direction"))
+                    target = &scene.dirLight.direction;
+                else if (cursor.keyword("ambient"))
+                    target = &scene.dirLight.ambient;
+                else if (cursor.keyword("diffuse"))
+                    target = &scene.dirLight.diffuse;
+                else if (cursor.keyword("specular"))
+                    target = &scene.dirLight.specular;
+                else
+                    return unexpected(cursor, error);
+                if (!cursor.vec3(*target))
+                    return fail(cursor, "dirlight values expect x y z", error);
+            }
+        }
+        else if (statement == "headlights" || statement == "lamplights")
+        {
+            float index;
+            glm::vec3 offset;
+            if (!cursor.number(index) || !cursor.keyword("offset") || !cursor.vec3(offset))
+                return fail(cursor, statement + " expects an index and offset x y z", error);
+            bool headlights = statement == "headlights";
+            size_t available = headlights ? scene.cars.size() : scene.layers.size();
+            if (index < 0.0f || index >= available)
+                return fail(cursor, statement + " index out of range", error);
+            (headlights ? scene.headlightCar : scene.lampLayer) = (int)index;
+            (headlights ? scene.headlightOffset : scene.lampLightOffset) = offset;
+        }
+        else if (statement == "fog")
+        {
+            while (!cursor.lineEnd())
+            {
+                bool read;
+                if (cursor.keyword("density"))
+                    read = cursor.number(scene.fogDensity);
+                else if (cursor.keyword("start"))
+                    read = cursor.number(scene.fogStart);
+                else if (cursor.keyword("end"))
+                    read = cursor.number(scene.fogEnd);
+                else if (cursor.keyword("color"))
+                    read = cursor.vec3(scene.fogColor);
+                else
+                    return unexpected(cursor, error);
+                if (!read)
+                    return fail(cursor, "fog option without a value", error);
+            }
+        }
+        else if (statement == "bloom")
+        {
+            while (!cursor.lineEnd())
+            {
+                float passes;
+                if (cursor.keyword("passes"))
+                {
+                    if (!cursor.number(passes) || passes < 1.0f)
+                        return fail(cursor, "passes expects a positive number", error);
+                    scene.bloomPasses = (unsigned int)passes;
+                }
+                else if (cursor.keyword("exposure"))
+                {
+                    if (!cursor.number(scene.exposure))
+                        return fail(cursor, "exposure expects a number", error);
+                }
+                else
+                    return unexpected(cursor, error);
+            }
+        }
+        else if (statement == "instance_scale")
+        {
+            if (!cursor.number(scene.instanceScale) || scene.instanceScale <= 0.0f)
+                return fail(cursor, "instance_scale expects a positive number", error);
+        }
+        else
+            return fail(cursor, "unknown statement " + statement, error);
+
+        if (!cursor.lineEnd())
+            return unexpected(cursor, error);
+    }
+    return true;
+}
+
+// Polls the modification time of a file, cheap enough to call every frame since it only asks the file system
+// every interval seconds.
+class FileWatcher
+{
+public:
+    float interval;
+
+    FileWatcher(const std::string &path, float interval = 0.5f) : interval(interval), path(path)
+    {
+        modified = modificationTime();
+    }
+
+    // true once per change of the file
+    bool Changed(float deltaTime)
+    {
+        elapsed += deltaTime;
+        if (elapsed < interval)
+            return false;
+        elapsed = 0.0f;
+        time_t now = modificationTime();
+        if (now == modified)
+            return false;
+        modified = now;
+        return true;
+    }
+
+private:
+    std::string path;
+    time_t modified;
+    float elapsed = 0.0f;
+
+    time_t modificationTime() const
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+    }
+};
+#endif
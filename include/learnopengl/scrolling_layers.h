@@ -0,0 +1,162 @@
+#ifndef SCROLLING_LAYERS_H
+#define SCROLLING_LAYERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/level_of_detail.h>
+#include <learnopengl/model.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+
+#include <vector>
+
+// one row of identical props that slides along +x and jumps back by period once it has moved that far,
+// e.g. the road pieces or the trees next to it
+struct ScrollingLayer {
+    Model *model = nullptr;
+    // where the first copy is at the start of the loop
+    glm::vec3 origin = glm::vec3(0.0f);
+    // distance along x between neighbouring copies
+    float spacing = 0.0f;
+    unsigned int count = 1;
+    float period = 1.0f;
+    // multiplier of the common scroll speed
+    float speed = 1.0f;
+    // scale and rotation of every copy, applied before the translation
+    glm::mat4 transform = glm::mat4(1.0f);
+    // drawn without back face culling
+    bool doubleSided = false;
+};
+
+// All scrolling layers of the scene as parallel arrays. The state of a layer is a single offset in [0, period),
+// kept outside in a plain float array so the simulation can copy and blend it; Advance moves every layer in one
+// pass and Submit queues the visible copies of consecutive layers of the same model as one instanced draw.
+class ScrollingLayers
+{
+public:
+    unsigned int Add(const ScrollingLayer &layer)
+    {
+        models.push_back(layer.model);
+        origins.push_back(layer.origin);
+        spacings.push_back(layer.spacing);
+        counts.push_back(layer.count);
+        periods.push_back(layer.period);
+        speeds.push_back(layer.speed);
+        transforms.push_back(layer.transform);
+        doubleSided.push_back(layer.doubleSided);
+        return (unsigned int)(models.size() - 1);
+    }
+
+    void Clear()
+    {
+        models.clear();
+        origins.clear();
+        spacings.clear();
+        counts.clear();
+        periods.clear();
+        speeds.clear();
+        transforms.clear();
+        doubleSided.clear();
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)models.size();
+    }
+
+    unsigned int Count(unsigned int layer) const
+    {
+        return counts[layer];
+    }
+
+    // moves every layer by distance times its speed and wraps it back into its period
+    void Advance(float *offsets, float distance) const
+    {
+        for (unsigned int i = 0; i < models.size(); i++)
+        {
+            offsets[i] += speeds[i] * distance;
+            if (offsets[i] >= periods[i])
+                offsets[i] -= periods[i];
+        }
+    }
+
+    // blends two states; a layer that wrapped in between is unwrapped first so it doesn't sweep backwards
+    void Blend(const float *previous, const float *current, float alpha, float *offsets) const
+    {
+        for (unsigned int i = 0; i < models.size(); i++)
+        {
+            float target = current[i] < previous[i] ? current[i] + periods[i] : current[i];
+            float offset = previous[i] + (target - previous[i]) * alpha;
+            offsets[i] = offset >= periods[i] ? offset - periods[i] : offset;
+        }
+    }
+
+    // where a copy of a layer is
+    glm::vec3 Position(unsigned int layer, unsigned int copy, const float *offsets) const
+    {
+        return origins[layer] + glm::vec3(offsets[layer] + spacings[layer] * float(copy), 0.0f, 0.0f);
+    }
+
+    // skips the copies outside the frustum or beyond the fog and groups the rest by the level of detail lods picks
+    // for the whole model; instances is scratch space for the model matrices of every level, reused between calls
+    void Submit(RenderQueue &queue, ShaderVariants &shaders, const float *offsets, const Frustum &frustum, const LodSelector &lods,
+                CullStats &stats, std::vector<std::vector<glm::mat4>> &instances) const
+    {
+        unsigned int first = 0;
+        while (first < models.size())
+        {
+            unsigned int last = first + 1;
+            while (last < models.size() && models[last] == models[first] && doubleSided[last] == doubleSided[first])
+                last++;
+
+            Model &model = *models[first];
+            bool twoSided = doubleSided[first];
+            unsigned int meshCount = (unsigned int)model.meshes.size();
+            instances.resize(model.lodErrors.size() + 1);
+            for (std::vector<glm::mat4> &level : instances)
+                level.clear();
+            for (unsigned int layer = first; layer < last; layer++)
+            {
+                for (unsigned int copy = 0; copy < counts[layer]; copy++)
+                {
+                    glm::mat4 transform = glm::translate(glm::mat4(1.0f), Position(layer, copy, offsets)) * transforms[layer];
+                    if (!frustum.Visible(model.bounds, transform))
+                    {
+                        stats.culled += meshCount;
+                        continue;
+                    }
+                    int level = lods.Select(model.lodErrors, model.bounds, transform);
+                    if (level < 0)
+                        stats.fogged += meshCount;
+                    else
+                        instances[level].push_back(transform);
+                }
+            }
+            first = last;
+
+            for (unsigned int level = 0; level < model.lodErrors.size() + 1; level++)
+            {
+                if (instances[level].empty())
+                    continue;
+                stats.Drawn((int)level, (unsigned int)instances[level].size() * meshCount);
+                unsigned int firstInstance = queue.AddInstances(instances[level]);
+                model.SubmitInstanced(queue, shaders, firstInstance, (unsigned int)instances[level].size(), twoSided, level);
+            }
+        }
+    }
+
+private:
+    std::vector<Model *> models;
+    std::vector<glm::vec3> origins;
+    std::vector<float> spacings;
+    std::vector<unsigned int> counts;
+    std::vector<float> periods;
+    std::vector<float> speeds;
+    std::vector<glm::mat4> transforms;
+    std::vector<bool> doubleSided;
+};
+#endif
@@ -4,18 +4,32 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/program_binary_cache.h>
+
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <set>
+#include <unordered_map>
 #include <common.h>
+
+// index into a Shader's uniform location table, resolved once with Shader::uniform()
+struct UniformHandle
+{
+    int index = -1;
+};
+
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly, every entry of defines becomes a #define line after #version
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string> &defines = std::vector<std::string>())
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
@@ -45,9 +59,9 @@ public:
             // close file handlers
             vShaderFile.close();
             fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            // convert stream into string, expanding #include "file" lines
+            vertexCode = injectDefines(resolveIncludes(vShaderStream.str(), vertexPathString), defines);
+            fragmentCode = injectDefines(resolveIncludes(fShaderStream.str(), fragmentPathString), defines);
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
@@ -57,51 +71,29 @@ public:
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = injectDefines(resolveIncludes(gShaderStream.str(), geometryPathString), defines);
             }
         }
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        // 2. link the program, from the driver's binary of an earlier run when the sources haven't changed
+        std::chrono::steady_clock::time_point linkStart = std::chrono::steady_clock::now();
+        ID = glCreateProgram();
+        uint64_t binaryKey = ProgramBinaryCache::Key(vertexCode + '\0' + fragmentCode + '\0' + geometryCode);
+        ProgramBinaryCache::Stats &stats = ProgramBinaryCache::Statistics();
+        if (ProgramBinaryCache::Load(ID, binaryKey))
+            stats.loaded++;
+        else
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            compileAndLink(vertexCode, fragmentCode, geometryPath != nullptr ? &geometryCode : nullptr);
+            ProgramBinaryCache::Save(ID, binaryKey);
+            stats.compiled++;
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - linkStart).count();
+        // 3. cache the locations of all active uniforms so setters never query the driver
+        cacheUniformLocations();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -109,66 +101,306 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // binds a uniform block of this program to a uniform buffer binding point, missing blocks are ignored
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &name, unsigned int binding)
+    {
+        GLuint blockIndex = glGetUniformBlockIndex(ID, name.c_str());
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, blockIndex, binding);
+    }
+    // resolves a uniform name to a handle for the handle based setters, unknown names give a handle that is ignored
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        UniformHandle handle;
+        std::unordered_map<std::string, int>::const_iterator it = uniformIndices.find(name);
+        if (it != uniformIndices.end())
+            handle.index = it->second;
+        return handle;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // handle based uniform functions, no string hashing and no driver lookups
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(location(handle), (int)value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(location(handle), value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(location(handle), value);
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        glUniform2fv(location(handle), 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(location(handle), 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, float x, float y, float z) const
+    {
+        glUniform3f(location(handle), x, y, z);
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(location(handle), 1, &value[0]);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(location(handle), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location(handle), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // uniform name -> index into uniformLocations, filled once after linking
+    std::unordered_map<std::string, int> uniformIndices;
+    std::vector<GLint> uniformLocations;
+
+    GLint location(UniformHandle handle) const
+    {
+        return handle.index >= 0 ? uniformLocations[handle.index] : -1;
+    }
+
+    GLint location(const std::string &name) const
+    {
+        return location(uniform(name));
+    }
+
+    // enumerates the active uniforms of the linked program into the location table.
+    // arrays are registered per element ("weight[3]") and under their bare name, structs per member.
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(maxLength + 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+
+            if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                registerUniform(base);
+                for (GLint element = 0; element < size; element++)
+                    registerUniform(base + "[" + std::to_string(element) + "]");
+            }
+            else
+                registerUniform(name);
+        }
+    }
+
+    void registerUniform(const std::string &name)
+    {
+        // uniforms that live in a uniform block have no location
+        GLint loc = glGetUniformLocation(ID, name.c_str());
+        if (loc == -1 || uniformIndices.count(name))
+            return;
+        uniformIndices[name] = (int)uniformLocations.size();
+        uniformLocations.push_back(loc);
+    }
+
+    // compiles the stages and links them into ID
+    // ------------------------------------------------------------------------
+    void compileAndLink(const std::string &vertexCode, const std::string &fragmentCode, const std::string *geometryCode)
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        // if geometry shader is given, compile geometry shader
+        unsigned int geometry;
+        if(geometryCode != nullptr)
+        {
+            const char * gShaderCode = geometryCode->c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+            checkCompileErrors(geometry, "GEOMETRY");
+        }
+        // shader Program
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if(geometryCode != nullptr)
+            glAttachShader(ID, geometry);
+        ProgramBinaryCache::PrepareLink(ID);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        if(geometryCode != nullptr)
+            glDeleteShader(geometry);
+    }
+
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // replaces every #include "file" line with the contents of that file, resolved relative to the including file
+    // ------------------------------------------------------------------------
+    static std::string resolveIncludes(const std::string &code, const std::string &path)
+    {
+        std::set<std::string> included;
+        included.insert(normalizePath(path));
+        return resolveIncludes(code, path, included);
+    }
+
+    // every file is pasted once per program, like with #pragma once, which also ends files that include each other
+    // ------------------------------------------------------------------------
+    static std::string resolveIncludes(const std::string &code, const std::string &path,
+                                       std::set<std::string> &included)
+    {
+        std::stringstream in(code);
+        std::string result, line;
+        while (std::getline(in, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+            {
+                size_t open = line.find('"', start);
+                size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close != std::string::npos)
+                {
+                    std::string name = line.substr(open + 1, close - open - 1);
+                    std::string includePath = normalizePath(directoryOf(path) + name);
+                    if (!included.insert(includePath).second)
+                        continue;
+                    std::string contents = readFileContents(includePath);
+                    if (contents.empty())
+                        std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+                    result += resolveIncludes(contents, includePath, included);
+                    continue;
+                }
+            }
+            result += line;
+            result += '\n';
+        }
+        return result;
+    }
+
+    // drops the "." and "dir/.." parts of a path, so one file reached by two spellings is still one file
+    // ------------------------------------------------------------------------
+    static std::string normalizePath(const std::string &path)
+    {
+        std::vector<std::string> parts;
+        std::stringstream in(path);
+        std::string part;
+        while (std::getline(in, part, '/'))
+        {
+            if (part.empty() || part == ".")
+                continue;
+            if (part == ".." && !parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else
+                parts.push_back(part);
+        }
+        std::string result = !path.empty() && path[0] == '/' ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++)
+            result += (i > 0 ? "/" : "") + parts[i];
+        return result;
+    }
+
+    // puts the defines right after the #version line, which has to stay the first statement of the source
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string &code, const std::vector<std::string> &defines)
+    {
+        if (defines.empty())
+            return code;
+        std::string lines;
+        for (const std::string &define : defines)
+            lines += "#define " + define + "\n";
+        size_t version = code.find("#version");
+        if (version == std::string::npos)
+            return lines + code;
+        size_t lineEnd = code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return code + "\n" + lines;
+        return code.substr(0, lineEnd + 1) + lines + code.substr(lineEnd + 1);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
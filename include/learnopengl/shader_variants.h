@@ -0,0 +1,97 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compiled variants of one übershader, keyed by the features they are built with. A feature is a #define placed
+// right after #version, so a variant pays only for the parts of the shader its meshes use. Variants are compiled
+// the first time they are asked for and kept until Release().
+class ShaderVariants
+{
+public:
+    // material features, picked per mesh
+    static const unsigned int ALPHA_TEST = 1 << 0;
+    static const unsigned int SPECULAR_MAP = 1 << 1;
+    // scene features, the same for every mesh
+    static const unsigned int FOG = 1 << 2;
+    // NUM_SPOT_LIGHTS is stored as a count in the bits from here on, see SpotLights()
+    static const unsigned int SPOT_LIGHT_SHIFT = 8;
+    static const unsigned int MATERIAL_FEATURES = ALPHA_TEST | SPECULAR_MAP;
+
+    // per-program state that is not per frame: uniform block bindings, sampler units, constants
+    typedef std::function<void(Shader &)> Setup;
+
+    // features every variant is built with on top of the ones Get() is asked for
+    unsigned int shared = 0;
+
+    ShaderVariants(const std::string &vertexPath, const std::string &fragmentPath, const Setup &setup = Setup())
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), setup(setup)
+    {
+    }
+
+    static unsigned int SpotLights(unsigned int count)
+    {
+        return count << SPOT_LIGHT_SHIFT;
+    }
+
+    // the variant for a mesh with the given material features
+    Shader &Get(unsigned int features)
+    {
+        unsigned int mask = features | shared;
+        std::unique_ptr<Shader> &variant = variants[mask];
+        if (!variant)
+        {
+            variant.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, Defines(mask)));
+            if (setup)
+                setup(*variant);
+        }
+        return *variant;
+    }
+
+    // runs f on every variant compiled so far, e.g. to set the per-frame uniforms
+    void ForEach(const std::function<void(Shader &)> &f)
+    {
+        for (std::pair<const unsigned int, std::unique_ptr<Shader>> &variant : variants)
+            f(*variant.second);
+    }
+
+    unsigned int Count() const
+    {
+        return (unsigned int)variants.size();
+    }
+
+    void Release()
+    {
+        for (std::pair<const unsigned int, std::unique_ptr<Shader>> &variant : variants)
+            glDeleteProgram(variant.second->ID);
+        variants.clear();
+    }
+
+    // the #define lines of a feature mask, without the #define
+    static std::vector<std::string> Defines(unsigned int features)
+    {
+        std::vector<std::string> defines;
+        if (features & ALPHA_TEST)
+            defines.push_back("ALPHA_TEST");
+        if (features & SPECULAR_MAP)
+            defines.push_back("SPECULAR_MAP");
+        if (features & FOG)
+            defines.push_back("FOG");
+        defines.push_back("NUM_SPOT_LIGHTS " + std::to_string(features >> SPOT_LIGHT_SHIFT));
+        return defines;
+    }
+
+private:
+    std::string vertexPath, fragmentPath;
+    Setup setup;
+    std::map<unsigned int, std::unique_ptr<Shader>> variants;
+};
+#endif
@@ -0,0 +1,88 @@
+#ifndef SKYBOX_H
+#define SKYBOX_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+
+// Keeps every skybox cubemap resident on the GPU, keyed by set name (the folder under resources/textures/).
+// All decoding and uploading happens in Load(), so switching skies at runtime is a plain lookup.
+class SkyboxCache
+{
+public:
+    // number of cubemap textures created so far, lets the caller verify nothing is allocated after startup
+    unsigned int textureAllocations = 0;
+
+    // decodes the six faces of a skybox set once and keeps the cubemap resident
+    unsigned int Load(const std::string &name)
+    {
+        std::map<std::string, unsigned int>::iterator it = cubemaps.find(name);
+        if (it != cubemaps.end())
+            return it->second;
+
+        std::string directory = "resources/textures/" + name + "/";
+        std::vector<std::string> faces = {
+                FileSystem::getPath(directory + "right.png"),
+                FileSystem::getPath(directory + "left.png"),
+                FileSystem::getPath(directory + "top.png"),
+                FileSystem::getPath(directory + "bottom.png"),
+                FileSystem::getPath(directory + "front.png"),
+                FileSystem::getPath(directory + "back.png")
+        };
+        unsigned int textureID = loadCubemap(faces);
+        cubemaps[name] = textureID;
+        return textureID;
+    }
+
+    // returns the resident cubemap of an already loaded set, 0 if it was never loaded
+    unsigned int Get(const std::string &name) const
+    {
+        std::map<std::string, unsigned int>::const_iterator it = cubemaps.find(name);
+        return it != cubemaps.end() ? it->second : 0;
+    }
+
+    void Release()
+    {
+        for (auto &entry : cubemaps)
+            glDeleteTextures(1, &entry.second);
+        cubemaps.clear();
+    }
+
+private:
+    std::map<std::string, unsigned int> cubemaps;
+
+    unsigned int loadCubemap(const std::vector<std::string> &faces)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        textureAllocations++;
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+        int width, height, nrChannels;
+        for (unsigned int i = 0; i < faces.size(); i++){
+            unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+            if (data){
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+                stbi_image_free(data);
+            }
+            else{
+                std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
+                stbi_image_free(data);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        return textureID;
+    }
+};
+#endif
@@ -0,0 +1,252 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/texture_streamer.h>
+
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <iterator>
+#include <iostream>
+
+// decoded pixels of one image file, owned until the texture is uploaded
+struct ImageData {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unsigned char *pixels = nullptr;
+    // filled by TextureCache::Inspect on a loading thread, so a miss doesn't read the file again on the GL thread:
+    // the resolved path and, if the file could be read, its content key
+    std::string filename;
+    bool hashed = false;
+    uint64_t hash = 0;
+    uint64_t size = 0;
+};
+
+unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
+
+ImageData DecodeImage(const char *path, const std::string &directory);
+
+unsigned int TextureFromImage(ImageData &image, const char *path);
+
+// Process-wide material textures. A file is looked up by its resolved absolute path first and by the hash of
+// its contents second, so the same image referenced from different models, or copied into every model's folder,
+// becomes one texture. Every Acquire() takes a reference that Release() gives back.
+class TextureCache
+{
+public:
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    // estimated uncompressed texture memory, with mipmaps, that hits did not have to allocate again
+    size_t bytesSaved = 0;
+    size_t bytesLoaded = 0;
+
+    // with a streamer misses come back as placeholders that are filled in later, without one they load right away
+    explicit TextureCache(TextureStreamer *streamer = nullptr) : streamer(streamer) {}
+
+    bool Streaming() const
+    {
+        return streamer != nullptr;
+    }
+
+    // returns the texture for path relative to directory. image may hold the pixels decoded ahead of time,
+    // they are uploaded on a miss and freed on a hit, and what Inspect() found out about the file, which is used
+    // instead of reading it here. normalMap lets the streamer pick a two channel encoding.
+    unsigned int Acquire(const std::string &path, const std::string &directory, ImageData *image = nullptr, bool normalMap = false)
+    {
+        bool inspected = image && !image->filename.empty();
+        std::string filename = inspected ? image->filename : resolve(directory + '/' + path);
+        std::unordered_map<std::string, unsigned int>::iterator named = byPath.find(filename);
+        if (named != byPath.end())
+            return hit(named->second, image);
+
+        ContentKey key(0, 0);
+        bool hashed;
+        if (inspected)
+        {
+            hashed = image->hashed;
+            key = ContentKey(image->hash, image->size);
+        }
+        else
+            hashed = MeshCache::hashFile(filename, key.first, key.second);
+        if (hashed)
+        {
+            std::map<ContentKey, unsigned int>::iterator same = byContent.find(key);
+            if (same != byContent.end())
+            {
+                byPath[filename] = same->second;
+                return hit(same->second, image);
+            }
+        }
+
+        misses++;
+        Entry entry;
+        entry.bytes = estimateBytes(filename, image);
+        if (image && image->pixels)
+            entry.id = TextureFromImage(*image, path.c_str());
+        else if (streamer)
+            entry.id = streamer->Request(path, directory, normalMap);
+        else
+            entry.id = TextureFromFile(path.c_str(), directory);
+        bytesLoaded += entry.bytes;
+
+        byPath[filename] = entry.id;
+        if (hashed)
+            byContent[key] = entry.id;
+        entries[entry.id] = entry;
+        return entry.id;
+    }
+
+    // drops one reference, the texture is deleted with the last one
+    void Release(unsigned int id)
+    {
+        std::unordered_map<unsigned int, Entry>::iterator entry = entries.find(id);
+        if (entry == entries.end() || --entry->second.references > 0)
+            return;
+        glDeleteTextures(1, &id);
+        entries.erase(entry);
+        for (std::unordered_map<std::string, unsigned int>::iterator it = byPath.begin(); it != byPath.end();)
+            it = it->second == id ? byPath.erase(it) : std::next(it);
+        for (std::map<ContentKey, unsigned int>::iterator it = byContent.begin(); it != byContent.end();)
+            it = it->second == id ? byContent.erase(it) : std::next(it);
+    }
+
+    size_t Size() const
+    {
+        return entries.size();
+    }
+
+    // resolves and hashes the file of image and reads its header if it isn't decoded, safe to call from worker
+    // threads; Acquire() then only looks the results up
+    static void Inspect(ImageData &image, const std::string &path, const std::string &directory)
+    {
+        image.filename = resolve(directory + '/' + path);
+        image.hashed = MeshCache::hashFile(image.filename, image.hash, image.size);
+        if (!image.pixels && !stbi_info(image.filename.c_str(), &image.width, &image.height, &image.components))
+            image.width = image.height = image.components = 0;
+    }
+
+    // GPU memory of every texture in the cache, each shared texture counted once
+    size_t TextureMemory() const
+    {
+        size_t bytes = 0;
+        for (const std::pair<const unsigned int, Entry> &entry : entries)
+            bytes += TextureCompressor::TextureBytes(entry.first);
+        return bytes;
+    }
+
+private:
+    // content hash and file size
+    typedef std::pair<uint64_t, uint64_t> ContentKey;
+
+    struct Entry {
+        unsigned int id = 0;
+        unsigned int references = 1;
+        size_t bytes = 0;
+    };
+
+    TextureStreamer *streamer;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::map<ContentKey, unsigned int> byContent;
+    std::unordered_map<unsigned int, Entry> entries;
+
+    unsigned int hit(unsigned int id, ImageData *image)
+    {
+        Entry &entry = entries[id];
+        entry.references++;
+        hits++;
+        bytesSaved += entry.bytes;
+        if (image && image->pixels)
+        {
+            stbi_image_free(image->pixels);
+            image->pixels = nullptr;
+        }
+        return id;
+    }
+
+    static std::string resolve(const std::string &filename)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(filename.c_str(), resolved))
+            return resolved;
+        return filename;
+    }
+
+    // uncompressed size of the texture with its mip chain, read from the image header when nothing is known yet
+    static size_t estimateBytes(const std::string &filename, const ImageData *image)
+    {
+        int width, height, components;
+        if (image && image->components > 0)
+        {
+            width = image->width;
+            height = image->height;
+            components = image->components;
+        }
+        else if (!stbi_info(filename.c_str(), &width, &height, &components))
+            return 0;
+        return (size_t)width * height * components * 4 / 3;
+    }
+};
+
+
+unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma)
+{
+    ImageData image = DecodeImage(path, directory);
+    return TextureFromImage(image, path);
+}
+
+// decodes an image relative to directory, safe to call from worker threads
+ImageData DecodeImage(const char *path, const std::string &directory)
+{
+    std::string filename = std::string(path);
+    filename = directory + '/' + filename;
+
+    ImageData image;
+    image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    return image;
+}
+
+// uploads decoded pixels into a new mipmapped texture and frees them
+unsigned int TextureFromImage(ImageData &image, const char *path)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (image.pixels)
+    {
+        GLenum format;
+        if (image.components == 1)
+            format = GL_RED;
+        else if (image.components == 3)
+            format = GL_RGB;
+        else if (image.components == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(image.pixels);
+        image.pixels = nullptr;
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    }
+
+    return textureID;
+}
+#endif
@@ -0,0 +1,471 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mesh_cache.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+
+// S3TC is an extension in GL 3.3 and not part of the bundled glad, RGTC (BC4/BC5) is core
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Block compressed textures with their whole mip chain, cached next to the source image as <image>.texcache.
+// Layout: TextureCacheHeader, then per level a uint32 byte count followed by the blocks of that level. Like the
+// mesh cache it is only used when the version and the hash of the source file match.
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+enum TextureEncoding {
+    TEXTURE_UNCOMPRESSED = 0,
+    TEXTURE_BC1,    // opaque color
+    TEXTURE_BC3,    // color with alpha
+    TEXTURE_BC4,    // single channel
+    TEXTURE_BC5     // two channels, normal maps
+};
+
+struct TextureCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t encoding;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t reserved;
+};
+
+// mip chain of one block compressed image, every level packed back to back in data
+struct CompressedImage {
+    TextureEncoding encoding = TEXTURE_UNCOMPRESSED;
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> levelSizes;
+    std::vector<unsigned char> data;
+};
+
+// what gets compressed and how
+struct CompressionSettings {
+    bool enabled = true;
+    // set by TextureCompressor::DetectSupport(), without it BC1 and BC3 images stay uncompressed
+    bool s3tcSupported = false;
+    // images whose file name contains one of these keep full quality, block artifacts make small text unreadable
+    std::vector<std::string> uncompressedPatterns = {"gauge"};
+};
+
+class TextureCompressor
+{
+public:
+    // checks GL_EXT_texture_compression_s3tc, needs a current context
+    static void DetectSupport(CompressionSettings &settings)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && std::strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+                settings.s3tcSupported = true;
+        }
+    }
+
+    static GLenum GLFormat(TextureEncoding encoding)
+    {
+        switch (encoding)
+        {
+            case TEXTURE_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case TEXTURE_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case TEXTURE_BC4: return GL_COMPRESSED_RED_RGTC1;
+            case TEXTURE_BC5: return GL_COMPRESSED_RG_RGTC2;
+            default: return 0;
+        }
+    }
+
+    // encoding for an image with the given channel count, TEXTURE_UNCOMPRESSED when it should not be compressed
+    static TextureEncoding Choose(const CompressionSettings &settings, const std::string &filename, int components, bool normalMap)
+    {
+        if (!settings.enabled)
+            return TEXTURE_UNCOMPRESSED;
+        std::string name = filename.substr(filename.find_last_of('/') + 1);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        for (const std::string &pattern : settings.uncompressedPatterns)
+            if (name.find(pattern) != std::string::npos)
+                return TEXTURE_UNCOMPRESSED;
+
+        if (normalMap && components >= 2)
+            return TEXTURE_BC5;
+        if (components == 1)
+            return TEXTURE_BC4;
+        // grey with alpha, rare enough to not deserve its own path
+        if (components == 2)
+            return TEXTURE_UNCOMPRESSED;
+        if (!settings.s3tcSupported)
+            return TEXTURE_UNCOMPRESSED;
+        return components == 4 ? TEXTURE_BC3 : TEXTURE_BC1;
+    }
+
+    static std::string CachePath(const std::string &sourcePath)
+    {
+        return sourcePath + ".texcache";
+    }
+
+    // reads the cached mip chain of sourcePath, returns false if it is missing, stale or of another encoding
+    static bool Load(const std::string &sourcePath, TextureEncoding encoding, CompressedImage &image)
+    {
+        uint64_t sourceHash, sourceSize;
+        if (!MeshCache::hashFile(sourcePath, sourceHash, sourceSize))
+            return false;
+        std::ifstream in(CachePath(sourcePath), std::ios::binary);
+        if (!in)
+            return false;
+
+        TextureCacheHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, "LOGLTEX", 8) != 0 || header.version != TEXTURE_CACHE_VERSION ||
+            header.encoding != (uint32_t)encoding || header.sourceHash != sourceHash || header.sourceSize != sourceSize)
+            return false;
+
+        image.encoding = encoding;
+        image.width = (int)header.width;
+        image.height = (int)header.height;
+        image.levelSizes.resize(header.levels);
+        image.data.clear();
+        for (uint32_t &size : image.levelSizes)
+        {
+            if (!in.read(reinterpret_cast<char*>(&size), sizeof(size)))
+                return false;
+            size_t offset = image.data.size();
+            image.data.resize(offset + size);
+            if (!in.read(reinterpret_cast<char*>(image.data.data() + offset), size))
+                return false;
+        }
+        return true;
+    }
+
+    // writes the mip chain for sourcePath through a temporary file, like MeshCache::Save
+    static void Save(const std::string &sourcePath, const CompressedImage &image)
+    {
+        uint64_t sourceHash, sourceSize;
+        if (!MeshCache::hashFile(sourcePath, sourceHash, sourceSize))
+            return;
+
+        std::string cachePath = CachePath(sourcePath);
+        std::string temporaryPath = cachePath + ".tmp";
+        std::ofstream out(temporaryPath, std::ios::binary);
+        if (!out)
+            return;
+
+        TextureCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "LOGLTEX", 8);
+        header.version = TEXTURE_CACHE_VERSION;
+        header.encoding = image.encoding;
+        header.sourceHash = sourceHash;
+        header.sourceSize = sourceSize;
+        header.width = (uint32_t)image.width;
+        header.height = (uint32_t)image.height;
+        header.levels = (uint32_t)image.levelSizes.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        size_t offset = 0;
+        for (uint32_t size : image.levelSizes)
+        {
+            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.write(reinterpret_cast<const char*>(image.data.data() + offset), size);
+            offset += size;
+        }
+        out.close();
+        if (!out || std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::cout << "TEXTURE_CACHE:: failed to write " << cachePath << std::endl;
+            std::remove(temporaryPath.c_str());
+        }
+    }
+
+    // builds a box filtered mip chain down to 1x1 and block compresses every level
+    static CompressedImage Compress(const unsigned char *pixels, int width, int height, int components, TextureEncoding encoding)
+    {
+        CompressedImage image;
+        image.encoding = encoding;
+        image.width = width;
+        image.height = height;
+
+        // work on RGBA, missing channels are filled like GL fills them when sampling
+        std::vector<unsigned char> level((size_t)width * height * 4);
+        for (size_t i = 0; i < (size_t)width * height; i++)
+        {
+            const unsigned char *source = pixels + i * components;
+            unsigned char *target = &level[i * 4];
+            target[0] = source[0];
+            target[1] = components >= 2 ? source[1] : 0;
+            target[2] = components >= 3 ? source[2] : 0;
+            target[3] = components == 4 ? source[3] : 255;
+        }
+
+        while (true)
+        {
+            size_t offset = image.data.size();
+            compressLevel(level, width, height, encoding, image.data);
+            image.levelSizes.push_back((uint32_t)(image.data.size() - offset));
+            if (width == 1 && height == 1)
+                break;
+            level = downsample(level, width, height);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return image;
+    }
+
+    // GPU memory of a texture summed over all its levels
+    static size_t TextureBytes(unsigned int textureID)
+    {
+        size_t bytes = 0;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for (GLint level = 0; ; level++)
+        {
+            GLint width = 0, height = 0, compressed = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+            if (width == 0 || height == 0)
+                break;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+            if (compressed)
+            {
+                GLint size = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+                bytes += size;
+            }
+            else
+            {
+                GLint bits = 0, channel = 0;
+                const GLenum channels[4] = {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE};
+                for (GLenum name : channels)
+                {
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, name, &channel);
+                    bits += channel;
+                }
+                bytes += (size_t)width * height * bits / 8;
+            }
+        }
+        return bytes;
+    }
+
+private:
+    static std::vector<unsigned char> downsample(const std::vector<unsigned char> &level, int width, int height)
+    {
+        int targetWidth = std::max(1, width / 2);
+        int targetHeight = std::max(1, height / 2);
+        std::vector<unsigned char> target((size_t)targetWidth * targetHeight * 4);
+        for (int y = 0; y < targetHeight; y++)
+        {
+            int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < targetWidth; x++)
+            {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; c++)
+                {
+                    int sum = level[((size_t)y0 * width + x0) * 4 + c] + level[((size_t)y0 * width + x1) * 4 + c] +
+                              level[((size_t)y1 * width + x0) * 4 + c] + level[((size_t)y1 * width + x1) * 4 + c];
+                    target[((size_t)y * targetWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        return target;
+    }
+
+    static void compressLevel(const std::vector<unsigned char> &level, int width, int height, TextureEncoding encoding, std::vector<unsigned char> &out)
+    {
+        unsigned char block[64];
+        for (int by = 0; by < height; by += 4)
+        {
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                // edge blocks repeat the last row and column
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                    {
+                        size_t source = ((size_t)std::min(by + y, height - 1) * width + std::min(bx + x, width - 1)) * 4;
+                        std::memcpy(block + (y * 4 + x) * 4, &level[source], 4);
+                    }
+
+                size_t offset = out.size();
+                if (encoding == TEXTURE_BC1)
+                {
+                    out.resize(offset + 8);
+                    compressColorBlock(block, &out[offset]);
+                }
+                else if (encoding == TEXTURE_BC3)
+                {
+                    out.resize(offset + 16);
+                    compressChannelBlock(block, 3, &out[offset]);
+                    compressColorBlock(block, &out[offset + 8]);
+                }
+                else if (encoding == TEXTURE_BC4)
+                {
+                    out.resize(offset + 8);
+                    compressChannelBlock(block, 0, &out[offset]);
+                }
+                else
+                {
+                    out.resize(offset + 16);
+                    compressChannelBlock(block, 0, &out[offset]);
+                    compressChannelBlock(block, 1, &out[offset + 8]);
+                }
+            }
+        }
+    }
+
+    static uint16_t pack565(const float color[3])
+    {
+        int r = std::min(31, std::max(0, (int)(color[0] * 31.0f / 255.0f + 0.5f)));
+        int g = std::min(63, std::max(0, (int)(color[1] * 63.0f / 255.0f + 0.5f)));
+        int b = std::min(31, std::max(0, (int)(color[2] * 31.0f / 255.0f + 0.5f)));
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpack565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // BC1 color block: endpoints on the principal axis of the 16 colors, always in four color mode
+    static void compressColorBlock(const unsigned char *block, unsigned char *out)
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += block[i * 4 + c] / 16.0f;
+
+        float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+            covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+            covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+        }
+
+        // power iteration for the principal axis
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3] = {
+                    covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                    covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                    covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+            };
+            float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float minimum = 1e30f, maximum = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+            minimum = std::min(minimum, t);
+            maximum = std::max(maximum, t);
+        }
+        float lengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float high[3], low[3];
+        for (int c = 0; c < 3; c++)
+        {
+            high[c] = mean[c] + axis[c] * maximum / lengthSquared;
+            low[c] = mean[c] + axis[c] * minimum / lengthSquared;
+        }
+
+        uint16_t color0 = pack565(high), color1 = pack565(low);
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            unpack565(color0, palette[0]);
+            unpack565(color1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestDistance = 1 << 30;
+                for (int p = 0; p < 4; p++)
+                {
+                    int distance = 0;
+                    for (int c = 0; c < 3; c++)
+                        distance += (block[i * 4 + c] - palette[p][c]) * (block[i * 4 + c] - palette[p][c]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (i * 2);
+            }
+        }
+
+        out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+        out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+
+    // BC4 block of one channel of the RGBA block, used for BC3 alpha and both BC5 channels
+    static void compressChannelBlock(const unsigned char *block, int channel, unsigned char *out)
+    {
+        int minimum = 255, maximum = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            minimum = std::min(minimum, (int)block[i * 4 + channel]);
+            maximum = std::max(maximum, (int)block[i * 4 + channel]);
+        }
+
+        // maximum > minimum selects the eight value mode
+        uint64_t indices = 0;
+        if (maximum != minimum)
+        {
+            int palette[8];
+            palette[0] = maximum;
+            palette[1] = minimum;
+            for (int p = 2; p < 8; p++)
+                palette[p] = ((8 - p) * maximum + (p - 1) * minimum) / 7;
+            for (int i = 0; i < 16; i++)
+            {
+                int value = block[i * 4 + channel];
+                int best = 0;
+                for (int p = 1; p < 8; p++)
+                    if (std::abs(value - palette[p]) < std::abs(value - palette[best]))
+                        best = p;
+                indices |= (uint64_t)best << (i * 3);
+            }
+        }
+
+        out[0] = (unsigned char)maximum;
+        out[1] = (unsigned char)minimum;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+};
+#endif
@@ -0,0 +1,263 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/texture_compressor.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Streams material textures in the background. Request() hands out a texture name right away that shows a
+// 1x1 placeholder; worker threads decode the file and Update(), called once per frame on the GL thread, copies
+// at most bytesPerFrame of decoded pixels into a mapped pixel buffer object. When an image is completely staged
+// the texture is respecified from the PBO under the same name, so meshes never have to patch their texture ids.
+// Images the CompressionSettings allow are block compressed with their mip chain on the workers, or read from the
+// .texcache container of a previous run, and uploaded level by level with glCompressedTexImage2D.
+class TextureStreamer
+{
+public:
+    // textures handed out by Request() that still show the placeholder
+    unsigned int pending = 0;
+    CompressionSettings compression;
+
+    explicit TextureStreamer(unsigned int threadCount = 2, size_t bytesPerFrame = 8 * 1024 * 1024)
+            : bytesPerFrame(bytesPerFrame)
+    {
+        glGenBuffers(1, &PBO);
+        TextureCompressor::DetectSupport(compression);
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this]() { work(); });
+    }
+
+    ~TextureStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        requestsChanged.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        for (Upload &upload : decoded)
+            stbi_image_free(upload.pixels);
+        stbi_image_free(current.pixels);
+    }
+
+    // creates the texture with a placeholder texel and queues the file for decoding
+    unsigned int Request(const std::string &path, const std::string &directory, bool normalMap = false)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        const unsigned char placeholder[4] = {128, 128, 128, 255};
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        Upload upload;
+        upload.textureID = textureID;
+        upload.filename = directory + '/' + path;
+        upload.normalMap = normalMap;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(upload);
+        }
+        requestsChanged.notify_one();
+        pending++;
+        return textureID;
+    }
+
+    // stages decoded pixels into the PBO within the per-frame budget and finishes every fully staged texture
+    void Update()
+    {
+        size_t budget = bytesPerFrame;
+        while (budget > 0)
+        {
+            if (current.textureID == 0 && !nextDecoded())
+                break;
+
+            size_t chunk = std::min(budget, current.size - current.staged);
+            std::memcpy(mapped + current.staged, current.source() + current.staged, chunk);
+            current.staged += chunk;
+            budget -= chunk;
+
+            if (current.staged == current.size)
+                finish();
+        }
+    }
+
+    void Release()
+    {
+        glDeleteBuffers(1, &PBO);
+    }
+
+private:
+    struct Upload {
+        unsigned int textureID = 0;
+        std::string filename;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        bool normalMap = false;
+        unsigned char *pixels = nullptr;
+        // used instead of pixels when the encoding is not TEXTURE_UNCOMPRESSED
+        CompressedImage compressed;
+        size_t size = 0;
+        size_t staged = 0;
+
+        const unsigned char *source() const
+        {
+            return compressed.encoding != TEXTURE_UNCOMPRESSED ? compressed.data.data() : pixels;
+        }
+    };
+
+    size_t bytesPerFrame;
+    unsigned int PBO;
+    // pointer into the mapped PBO while current is being staged
+    unsigned char *mapped = nullptr;
+    Upload current;
+
+    std::vector<std::thread> workers;
+    std::deque<Upload> requests;
+    std::deque<Upload> decoded;
+    std::mutex mutex;
+    std::condition_variable requestsChanged;
+    bool stopping = false;
+
+    void work()
+    {
+        while (true)
+        {
+            Upload upload;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                requestsChanged.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+                upload = requests.front();
+                requests.pop_front();
+            }
+            decode(upload);
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(upload);
+        }
+    }
+
+    // fills either pixels or compressed, size stays 0 if the file can't be read
+    void decode(Upload &upload)
+    {
+        TextureEncoding encoding = TEXTURE_UNCOMPRESSED;
+        if (stbi_info(upload.filename.c_str(), &upload.width, &upload.height, &upload.components))
+            encoding = TextureCompressor::Choose(compression, upload.filename, upload.components, upload.normalMap);
+
+        if (encoding != TEXTURE_UNCOMPRESSED && TextureCompressor::Load(upload.filename, encoding, upload.compressed))
+        {
+            upload.size = upload.compressed.data.size();
+            return;
+        }
+        upload.pixels = stbi_load(upload.filename.c_str(), &upload.width, &upload.height, &upload.components, 0);
+        if (!upload.pixels)
+            return;
+        if (encoding != TEXTURE_UNCOMPRESSED)
+        {
+            upload.compressed = TextureCompressor::Compress(upload.pixels, upload.width, upload.height, upload.components, encoding);
+            TextureCompressor::Save(upload.filename, upload.compressed);
+            stbi_image_free(upload.pixels);
+            upload.pixels = nullptr;
+            upload.size = upload.compressed.data.size();
+        }
+        else
+            upload.size = (size_t)upload.width * upload.height * upload.components;
+    }
+
+    // takes the next decoded image and maps a fresh PBO store for it, false if nothing is ready
+    bool nextDecoded()
+    {
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (decoded.empty())
+                    return false;
+                current = decoded.front();
+                decoded.pop_front();
+            }
+            if (current.size > 0)
+                break;
+            std::cout << "Texture failed to load at path: " << current.filename << std::endl;
+            current = Upload();
+            pending--;
+        }
+
+        // respecifying the store orphans whatever the GPU may still be reading from the previous upload
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, current.size, nullptr, GL_STREAM_DRAW);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, current.size,
+                                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return true;
+    }
+
+    // unmaps the staged image and respecifies the texture from the PBO
+    void finish()
+    {
+        GLenum format;
+        if (current.components == 1)
+            format = GL_RED;
+        else if (current.components == 3)
+            format = GL_RGB;
+        else
+            format = GL_RGBA;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        mapped = nullptr;
+
+        glBindTexture(GL_TEXTURE_2D, current.textureID);
+        if (current.compressed.encoding != TEXTURE_UNCOMPRESSED)
+        {
+            // the whole mip chain is in the PBO, level after level
+            GLenum compressedFormat = TextureCompressor::GLFormat(current.compressed.encoding);
+            int width = current.compressed.width, height = current.compressed.height;
+            size_t offset = 0;
+            GLint levels = (GLint)current.compressed.levelSizes.size();
+            for (GLint level = 0; level < levels; level++)
+            {
+                GLsizei size = (GLsizei)current.compressed.levelSizes[level];
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat, width, height, 0, size, (void*)offset);
+                offset += size;
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        else
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, current.width, current.height, 0, format, GL_UNSIGNED_BYTE, (void*)0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(current.pixels);
+        current = Upload();
+        pending--;
+    }
+};
+#endif
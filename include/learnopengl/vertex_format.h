@@ -0,0 +1,214 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/shader.h>
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// How mesh vertices are laid out on the GPU. Unpacked is Vertex as it is (56 bytes). Packed stores the normal
+// and tangent as 10:10:10:2 snorm with the bitangent reduced to its sign in the tangent's w, the UVs as half
+// floats and, if quantizedPositions, the position as 16-bit unorm within the mesh's bounding box (16 bytes
+// without tangents, 20 with). The shader sees the same vec3/vec2 inputs either way; quantized positions are
+// scaled back with the positionScale/positionOffset uniforms.
+struct VertexFormat {
+    bool packed = false;
+    bool tangents = true;
+    bool quantizedPositions = false;
+
+    // the packed format drops the bitangent, so it is only picked when the shader reads no aBitangent (location 4);
+    // tangents are only kept when it reads location 3
+    static VertexFormat ForShader(const Shader &shader)
+    {
+        bool used[16] = {};
+        int count = 0;
+        glGetProgramiv(shader.ID, GL_ACTIVE_ATTRIBUTES, &count);
+        for (int i = 0; i < count; i++)
+        {
+            char name[256];
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(shader.ID, i, sizeof(name), &length, &size, &type, name);
+            int location = glGetAttribLocation(shader.ID, name);
+            if (location >= 0 && location < 16)
+                used[location] = true;
+        }
+
+        VertexFormat format;
+        format.packed = !used[4];
+        format.tangents = !format.packed || used[3];
+        format.quantizedPositions = format.packed;
+        return format;
+    }
+
+    // the format a mesh with these bounds gets: quantized positions fall back to floats for meshes too big to
+    // stay within MAX_POSITION_ERROR
+    VertexFormat For(const BoundingVolume &bounds) const
+    {
+        VertexFormat format = *this;
+        if (format.quantizedPositions && !bounds.empty)
+        {
+            glm::vec3 extent = bounds.max - bounds.min;
+            float largest = std::max(extent.x, std::max(extent.y, extent.z));
+            format.quantizedPositions = largest / 65535.0f * 0.5f <= MAX_POSITION_ERROR;
+        }
+        return format;
+    }
+
+    // distinguishes the formats that need their own geometry buffer
+    unsigned int Key() const
+    {
+        return !packed ? 0 : 1 + (tangents ? 1 : 0) + (quantizedPositions ? 2 : 0);
+    }
+
+    unsigned int Stride() const
+    {
+        if (!packed)
+            return sizeof(Vertex);
+        return (quantizedPositions ? 8 : 12) + 4 + (tangents ? 4 : 0) + 4;
+    }
+
+    std::string Name() const
+    {
+        if (!packed)
+            return "float";
+        return std::string(quantizedPositions ? "packed 16-bit position" : "packed float position") +
+               (tangents ? " + tangent" : "");
+    }
+
+    // attribute pointers for the VAO and GL_ARRAY_BUFFER that are bound
+    void SetupAttributes() const
+    {
+        GLsizei stride = Stride();
+        if (!packed)
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+            return;
+        }
+
+        size_t offset = 0;
+        glEnableVertexAttribArray(0);
+        if (quantizedPositions)
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offset);
+        else
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        offset += quantizedPositions ? 8 : 12;
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+        offset += 4;
+        if (tangents)
+        {
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+            offset += 4;
+        }
+        else
+            glDisableVertexAttribArray(3);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+        glDisableVertexAttribArray(4);
+    }
+
+    // converts vertices into this format; scale and offset turn the stored position back into the original one
+    void Pack(const std::vector<Vertex> &vertices, const BoundingVolume &bounds, std::vector<unsigned char> &out,
+              glm::vec3 &scale, glm::vec3 &offset) const
+    {
+        scale = glm::vec3(1.0f);
+        offset = glm::vec3(0.0f);
+        out.resize(vertices.size() * Stride());
+        if (vertices.empty())
+            return;
+        if (!packed)
+        {
+            std::memcpy(&out[0], vertices.data(), out.size());
+            return;
+        }
+
+        glm::vec3 inverseScale(0.0f);
+        if (quantizedPositions)
+        {
+            offset = bounds.min;
+            scale = bounds.max - bounds.min;
+            for (int axis = 0; axis < 3; axis++)
+                inverseScale[axis] = scale[axis] > 0.0f ? 65535.0f / scale[axis] : 0.0f;
+        }
+
+        unsigned char *write = &out[0];
+        for (const Vertex &vertex : vertices)
+        {
+            if (quantizedPositions)
+            {
+                uint16_t position[4];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float quantized = std::floor((vertex.Position[axis] - offset[axis]) * inverseScale[axis] + 0.5f);
+                    position[axis] = (uint16_t)std::min(std::max(quantized, 0.0f), 65535.0f);
+                }
+                position[3] = 0;
+                write = put(write, position, sizeof(position));
+            }
+            else
+                write = put(write, &vertex.Position, sizeof(glm::vec3));
+
+            uint32_t normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+            write = put(write, &normal, sizeof(normal));
+            if (tangents)
+            {
+                // the bitangent is cross(N, T) or its opposite, only the sign needs storing
+                float sign = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+                uint32_t tangent = glm::packSnorm3x10_1x2(glm::vec4(vertex.Tangent, sign));
+                write = put(write, &tangent, sizeof(tangent));
+            }
+            uint16_t texCoords[2] = {glm::packHalf1x16(vertex.TexCoords.x), glm::packHalf1x16(vertex.TexCoords.y)};
+            write = put(write, texCoords, sizeof(texCoords));
+        }
+    }
+
+private:
+    // largest position error, in model units, quantization may introduce
+    static constexpr float MAX_POSITION_ERROR = 0.001f;
+
+    static unsigned char *put(unsigned char *write, const void *data, size_t size)
+    {
+        std::memcpy(write, data, size);
+        return write + size;
+    }
+};
+#endif
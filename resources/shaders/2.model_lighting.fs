@@ -1,29 +1,13 @@
 #version 330 core
+// built by ShaderVariants with the features a mesh needs: ALPHA_TEST, SPECULAR_MAP, FOG and NUM_SPOT_LIGHTS, the
+// number of headlights lit per fragment
 out vec4 FragColor;
 
-#define MAX_SPOT_LIGHTS 7
+#ifndef NUM_SPOT_LIGHTS
+#define NUM_SPOT_LIGHTS 2
+#endif
 
-struct DirLight {
-    vec3 direction;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "lights.glsl"
 
 struct Material {
     sampler2D texture_diffuse1;
@@ -35,12 +19,9 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+in float ViewDepth;
 
 uniform Material material;
-uniform DirLight dirLight;
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
-uniform SpotLight spotLight;
-uniform SpotLight spotLight1;
 uniform float transparent;
 
 // Fog
@@ -51,35 +32,39 @@ uniform vec3 fogColor;
 
 uniform vec3 viewPosition;
 
-vec3 CalcDirectionalLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirectionalLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
+#ifdef SPECULAR_MAP
     // specular shading blinn phong
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess * 4);
+    vec3 specular = light.specular * spec * specularColor;
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-
-    vec4 diffSample = texture(material.texture_diffuse1, TexCoords);
-    if(diffSample.a < 0.1)
-        discard;
-    vec3 diffuse = light.diffuse * diff * vec3(diffSample);
-//     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
     return (ambient + diffuse + specular);
 }
 
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     float diff = max(dot(normal, lightDir), 0.0);
 
+#ifdef SPECULAR_MAP
     //blinn phong
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess * 4);
+    vec3 specular = light.specular * spec * specularColor;
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
@@ -88,14 +73,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-
-    vec4 diffSample = texture(material.texture_diffuse1, TexCoords);
-    if(diffSample.a < 0.1)
-        discard;
-    vec3 diffuse = light.diffuse * diff * vec3(diffSample);
-//     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
 
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -107,20 +86,44 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 
 void main()
 {
+    // material, sampled once for all lights; cut-out texels are dropped before any lighting is done
+    vec4 diffSample = texture(material.texture_diffuse1, TexCoords);
+#ifdef ALPHA_TEST
+    if(diffSample.a < 0.1)
+        discard;
+#endif
+    vec3 albedo = diffSample.rgb;
+#ifdef SPECULAR_MAP
+    vec3 specularColor = texture(material.texture_specular1, TexCoords).rgb;
+#else
+    vec3 specularColor = vec3(0.0);
+#endif
+
+    // lights
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcDirectionalLight(dirLight, normal, viewDir);
-    result += CalcSpotLight(spotLight, normal, FragPos, viewDir);
-    result += CalcSpotLight(spotLight1, normal, FragPos, viewDir);
-    for (int i = 0; i < MAX_SPOT_LIGHTS; ++i) {
-        result += CalcSpotLight(spotLights[i], normal, FragPos, viewDir);
+    vec3 result = CalcDirectionalLight(dirLight, normal, viewDir, albedo, specularColor);
+#if NUM_SPOT_LIGHTS > 0
+    result += CalcSpotLight(spotLight, normal, FragPos, viewDir, albedo, specularColor);
+#endif
+#if NUM_SPOT_LIGHTS > 1
+    result += CalcSpotLight(spotLight1, normal, FragPos, viewDir, albedo, specularColor);
+#endif
+    // only the lamps whose cone reaches the cluster of this fragment
+    uvec2 cluster = LampCluster(gl_FragCoord.xy, ViewDepth);
+    for (uint i = cluster.x; i < cluster.x + cluster.y; ++i) {
+        result += CalcSpotLight(LampLight(i), normal, FragPos, viewDir, albedo, specularColor);
     }
 
+#ifdef FOG
     //fog
     float distance = length(FragPos - viewPosition);
     float fogFactor = (distance - fogStart) / (fogEnd - fogStart);
     fogFactor = clamp(fogFactor, 0.0, 1.0);
     vec3 finalColor = mix(result, fogColor, fogFactor);
+#else
+    vec3 finalColor = result;
+#endif
 
     FragColor = vec4(finalColor, transparent);
 }
\ No newline at end of file
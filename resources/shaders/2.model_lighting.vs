@@ -2,19 +2,30 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance model matrix, occupies locations 5-8
+layout (location = 5) in mat4 aInstanceModel;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+// distance in front of the camera, picks the light cluster
+out float ViewDepth;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform bool instanced;
+// packed meshes store positions relative to their bounding box, see VertexFormat
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    FragPos = vec3(modelMatrix * vec4(aPos * positionScale + positionOffset, 1.0));
     Normal = aNormal;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    vec4 viewPos = view * vec4(FragPos, 1.0);
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#version 330 core
+// lighting pass of the deferred path: the same lights and fog as 2.model_lighting.fs, evaluated once per pixel
+// from the G-buffer; built by ShaderVariants with the scene features FOG and NUM_SPOT_LIGHTS
+out vec4 FragColor;
+
+#ifndef NUM_SPOT_LIGHTS
+#define NUM_SPOT_LIGHTS 2
+#endif
+
+#include "lights.glsl"
+
+in vec2 TexCoords;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 view;
+uniform mat4 inverseViewProjection;
+uniform float shininess;
+
+// Fog
+uniform float fogStart;
+uniform float fogEnd;
+uniform vec3 fogColor;
+
+uniform vec3 viewPosition;
+
+vec3 CalcDirectionalLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading blinn phong
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess * 4);
+
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    //blinn phong
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess * 4);
+
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    // nothing was drawn here, the sky goes on top later
+    if (depth == 1.0)
+        discard;
+    vec4 position = inverseViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = position.xyz / position.w;
+    vec3 albedo = texture(gAlbedo, TexCoords).rgb;
+    vec3 specularColor = texture(gSpecular, TexCoords).rgb;
+    vec3 normal = texture(gNormal, TexCoords).xyz;
+
+    vec3 viewDir = normalize(viewPosition - fragPos);
+    vec3 result = CalcDirectionalLight(dirLight, normal, viewDir, albedo, specularColor);
+#if NUM_SPOT_LIGHTS > 0
+    result += CalcSpotLight(spotLight, normal, fragPos, viewDir, albedo, specularColor);
+#endif
+#if NUM_SPOT_LIGHTS > 1
+    result += CalcSpotLight(spotLight1, normal, fragPos, viewDir, albedo, specularColor);
+#endif
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    uvec2 cluster = LampCluster(gl_FragCoord.xy, viewDepth);
+    for (uint i = cluster.x; i < cluster.x + cluster.y; ++i) {
+        result += CalcSpotLight(LampLight(i), normal, fragPos, viewDir, albedo, specularColor);
+    }
+
+#ifdef FOG
+    //fog
+    float distance = length(fragPos - viewPosition);
+    float fogFactor = (distance - fogStart) / (fogEnd - fogStart);
+    fogFactor = clamp(fogFactor, 0.0, 1.0);
+    vec3 finalColor = mix(result, fogColor, fogFactor);
+#else
+    vec3 finalColor = result;
+#endif
+
+    FragColor = vec4(finalColor, 1.0);
+    // the sky is drawn with the depth test afterwards
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,33 @@
+#version 330 core
+// geometry pass of the deferred path, see include/learnopengl/gbuffer.h; built by ShaderVariants with the material
+// features ALPHA_TEST and SPECULAR_MAP
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gSpecular;
+layout (location = 2) out vec4 gNormal;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+};
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform Material material;
+
+void main()
+{
+    vec4 diffSample = texture(material.texture_diffuse1, TexCoords);
+#ifdef ALPHA_TEST
+    if(diffSample.a < 0.1)
+        discard;
+#endif
+    gAlbedo = vec4(diffSample.rgb, 1.0);
+#ifdef SPECULAR_MAP
+    gSpecular = vec4(texture(material.texture_specular1, TexCoords).rgb, 1.0);
+#else
+    gSpecular = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
+    gNormal = vec4(normalize(Normal), 0.0);
+}
@@ -0,0 +1,65 @@
+// Shared light set, filled by LightBuffer (include/learnopengl/lights.h) with one buffer update per frame.
+// Keep the struct layouts in sync with the CPU side.
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// std140: every float sits in the padding slot of the vec3 before it
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    SpotLight spotLight1;
+};
+
+// Street lamps, binned into view space clusters by LightClusters (include/learnopengl/light_clusters.h).
+// Keep the grid size in sync with the CPU side.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+
+// five texels per light, in the order of the SpotLight members
+uniform samplerBuffer lampLights;
+// first index and light count of every cluster
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+// pixels per tile, and the scale and bias that turn log(view depth) into a slice
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepth;
+
+// first index into lightIndices and number of lights of the cluster a fragment is in
+uvec2 LampCluster(vec2 fragCoord, float viewDepth)
+{
+    ivec2 tile = min(ivec2(fragCoord / clusterTileSize), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int slice = clamp(int(log(max(viewDepth, 1e-4)) * clusterDepth.x + clusterDepth.y), 0, CLUSTER_SLICES - 1);
+    return texelFetch(lightClusters, tile.x + CLUSTER_TILES_X * (tile.y + CLUSTER_TILES_Y * slice)).xy;
+}
+
+// the light at position entry of lightIndices
+SpotLight LampLight(uint entry)
+{
+    int base = int(texelFetch(lightIndices, int(entry)).x) * 5;
+    vec4 t0 = texelFetch(lampLights, base);
+    vec4 t1 = texelFetch(lampLights, base + 1);
+    vec4 t2 = texelFetch(lampLights, base + 2);
+    vec4 t3 = texelFetch(lampLights, base + 3);
+    vec4 t4 = texelFetch(lampLights, base + 4);
+    return SpotLight(t0.xyz, t0.w, t1.xyz, t1.w, t2.xyz, t2.w, t3.xyz, t3.w, t4.xyz, t4.w);
+}
@@ -13,8 +13,29 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_loader.h>
+#include <learnopengl/skybox.h>
+#include <learnopengl/lights.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/headless_context.h>
+#include <learnopengl/benchmark.h>
+#include <learnopengl/fixed_timestep.h>
+#include <learnopengl/scrolling_layers.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/level_of_detail.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/gbuffer.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/program_binary_cache.h>
 
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <unordered_map>
+#include <limits>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -26,8 +47,6 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadCubemap(vector<std::string> faces);
-
 // settings
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
@@ -42,26 +61,26 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-struct DirLight {
-    glm::vec3 direction;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-};
-
-struct SpotLight {
-    glm::vec3 position;
-    glm::vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
+// per-frame uniforms of a scene shader variant, resolved once when the variant is compiled
+struct LightingUniforms {
+    UniformHandle projection, view;
+    UniformHandle fogDensity, fogStart, fogEnd, fogColor;
+    UniformHandle viewPosition;
+    // deferred lighting pass only
+    UniformHandle inverseViewProjection;
+
+    static LightingUniforms Resolve(const Shader &shader) {
+        LightingUniforms uniforms;
+        uniforms.projection = shader.uniform("projection");
+        uniforms.view = shader.uniform("view");
+        uniforms.fogDensity = shader.uniform("fogDensity");
+        uniforms.fogStart = shader.uniform("fogStart");
+        uniforms.fogEnd = shader.uniform("fogEnd");
+        uniforms.fogColor = shader.uniform("fogColor");
+        uniforms.viewPosition = shader.uniform("viewPosition");
+        uniforms.inverseViewProjection = shader.uniform("inverseViewProjection");
+        return uniforms;
+    }
 };
 
 struct ProgramState {
@@ -75,41 +94,8 @@ struct ProgramState {
     bool move = true;
     bool skySwitch = false;
     bool hdrSwitch = false;
-
-    glm::vec3 putPosition = glm::vec3(-80.0f, 0.0f, 0.0f);
-    float putScale = 1.0f;
-
-    glm::vec3 nisanPosition1 = glm::vec3(11.0f, 1.57f, -1.1f);
-    float nisanScale1 = 0.7f;
-    glm::vec3 nisanPosition2 = glm::vec3(0.0f, 1.65f, 0.7f);
-    float nisanScale2 = 1.5f;
-    glm::vec3 nisanPosition3 = glm::vec3(-11.0f, 1.57f, -1.65f);
-    float nisanScale3 = 0.7f;
-    glm::vec3 nisanPosition4 = glm::vec3(-25.0f, 1.65f, 0.72f);
-    float nisanScale4 = 1.5f;
-
-    glm::vec3 drvoPosition = glm::vec3(-80.0f, 0.4f, 5.0f);
-    float drvoScale = 0.4f;
-
-    glm::vec3 pwrlPosition = glm::vec3(-64.8f, 0.8f, -5.0f);
-    float pwrlScale = 0.6f;
-
-    glm::vec3 lampPosition = glm::vec3(-90.0f, 0.8f, 3.0f);
-    float lampScale = 0.1f;
-
-    glm::vec3 travaPosition = glm::vec3(-100.0f, 0.35f, 10.0f);
-    glm::vec3 trava2Position = glm::vec3(-100.0f, 0.35f, -10.5f);
-    float travaScale = 1.0f;
-
-    glm::vec3 zgradePosition = glm::vec3(-140.0f, 17.0f, 63.0f);
-    float zgradeScale = 2.0f;
-
-    glm::vec3 planinaPosition = glm::vec3(80.0f, 0.0f, 0.0f);
-    float planinaScale = 30.0f;
-
-    glm::vec3 terrainPosition = glm::vec3(0.0f, 4.05f, 0.0f);
-    glm::vec3 terrain1Position = glm::vec3(-214.0f, 4.05f, 0.0f);
-    float terrainScale = 30.0f;
+    // G: the scene is lit once per pixel from the G-buffer instead of in every draw
+    bool deferred = false;
 
     SpotLight spotLight;
     SpotLight spotLight1;
@@ -153,60 +139,120 @@ void ProgramState::LoadFromFile(std::string filename) {
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+// everything the animation moves, advanced by updateScene at a fixed rate and blended by interpolateScene for
+// the frame that is being drawn
+struct SceneState {
+    // simulated seconds
+    float time = 0.0f;
+
+    // positions of the cars and which way they drive, true towards minX
+    std::vector<glm::vec3> cars;
+    std::vector<bool> carsForward;
+
+    // offset of every scrolling layer, see ScrollingLayers
+    std::vector<float> scroll;
+};
+
+void resetScene(const SceneDescription &description, const ScrollingLayers &layers, SceneState &state);
+
+void updateScene(SceneState &state, const SceneDescription &description, const ScrollingLayers &layers,
+                 float deltaTime, bool move);
+
+void interpolateScene(const SceneState &previous, const SceneState &current, const ScrollingLayers &layers,
+                      float alpha, SceneState &scene);
+
+void loadSceneModels(const SceneDescription &description, TextureCache &textureCache, std::deque<Model> &models,
+                     vector<string> &modelPaths, vector<Model *> &sceneModels);
+
+void buildLayers(const SceneDescription &description, const vector<Model *> &sceneModels, ScrollingLayers &layers);
+
+unsigned int sceneShaderFeatures(const SceneDescription &description);
+
+float sceneDrawDistance(const SceneDescription &description);
+
+void DrawImGui(ProgramState *programState, const TextureCache &textureCache, const Profiler &profiler,
+               const CullStats &cullStats, const GLStateTracker &glState, const LightClusters &lightClusters);
 
 unsigned int colorBuffers[2];
 unsigned int rboDepth;
 unsigned int pingpongColorbuffers[2];
+// targets of the deferred path, resized together with the hdr buffers
+GBuffer *gBuffer = nullptr;
+// size the scene is rendered at, the light clusters tile it
+unsigned int framebufferWidth = SCR_WIDTH, framebufferHeight = SCR_HEIGHT;
 
-float speed = 7.0f; // brzina puta
-float speedZgrada = 4.5f; // brzina zgrada
+float speed = 7.0f; // brzina puta, na pocetku i posle ucitavanja scene ona iz scene
 
+// the window's framebuffer, or the offscreen backbuffer of the headless benchmark
+unsigned int defaultFramebuffer = 0;
+bool headless = false;
 
-int main() {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// seconds since the first call, also usable without GLFW
+double elapsedSeconds() {
+    static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char **argv) {
+    Benchmark benchmark = Benchmark::FromArguments(argc, argv);
+    GLFWwindow *window = nullptr;
+    HeadlessContext headlessContext;
+    if (benchmark.enabled) {
+        // no window, everything that would go to the screen goes to an offscreen backbuffer
+        if (!headlessContext.Create(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
+        headless = true;
+        defaultFramebuffer = headlessContext.FBO;
+        GLCallCounter::Install();
+    } else {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    //msaa
-    glfwWindowHint(GLFW_SAMPLES, 4);
+        //msaa
+        glfwWindowHint(GLFW_SAMPLES, 4);
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Rollers", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Rollers", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
-    if (programState->ImGuiEnabled) {
+    // the benchmark always starts from the defaults so runs stay comparable
+    if (!benchmark.enabled)
+        programState->LoadFromFile("resources/program_state.txt");
+    programState->deferred = benchmark.deferred;
+    if (programState->ImGuiEnabled && window) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
     // Init Imgui
@@ -215,7 +261,8 @@ int main() {
     ImGuiIO &io = ImGui::GetIO();
     (void) io;
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    if (window)
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
 
     // configure global opengl state
@@ -234,12 +281,43 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    // programs linked in an earlier run are reused as long as the sources and the driver stay the same
+    ProgramBinaryCache::Init(headless ? (GLADloadproc) eglGetProcAddress : (GLADloadproc) glfwGetProcAddress);
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
     Shader bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
     Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
 
+    // all lights go to the GPU through one uniform buffer
+    LightBuffer lightBuffer;
+    // lamps go through the light clusters, every fragment only shades the ones that reach it
+    LightClusters lightClusters;
+    // every material gets a variant with only what it needs, variants are compiled when first asked for
+    std::unordered_map<unsigned int, LightingUniforms> lightingUniforms;
+    ShaderVariants sceneShaders("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs",
+                                [&lightBuffer, &lightClusters, &lightingUniforms](Shader &shader) {
+                                    shader.use();
+                                    lightBuffer.Bind(shader);
+                                    lightClusters.Bind(shader);
+                                    shader.setFloat("transparent", 1.0f);
+                                    shader.setFloat("material.shininess", 10.0f);
+                                    lightingUniforms[shader.ID] = LightingUniforms::Resolve(shader);
+                                });
+    ShaderVariants gBufferShaders("resources/shaders/2.model_lighting.vs", "resources/shaders/gbuffer.fs",
+                                  [&lightingUniforms](Shader &shader) {
+                                      lightingUniforms[shader.ID] = LightingUniforms::Resolve(shader);
+                                  });
+    // the deferred lighting pass, built with the same scene features as the forward variants
+    ShaderVariants deferredShaders("resources/shaders/deferred_lighting.vs", "resources/shaders/deferred_lighting.fs",
+                                   [&lightBuffer, &lightClusters, &lightingUniforms](Shader &shader) {
+                                       shader.use();
+                                       lightBuffer.Bind(shader);
+                                       lightClusters.Bind(shader);
+                                       GBuffer::Bind(shader);
+                                       shader.setFloat("shininess", 10.0f);
+                                       lightingUniforms[shader.ID] = LightingUniforms::Resolve(shader);
+                                   });
+
     float skyboxVertices[] = {
             // positions
             -1.0f,  1.0f, -1.0f,
@@ -299,52 +377,64 @@ int main() {
     // -----------
     stbi_set_flip_vertically_on_load(false);
 
-    Model put("resources/objects/okoloputnici/road/road.obj");
-    put.SetShaderTextureNamePrefix("material.");
-
-    Model auto1("resources/objects/Auti/roze_nissan/sx180.obj");
-    auto1.SetShaderTextureNamePrefix("material.");
-    Model auto2("resources/objects/Auti/beli_nissan_s15/s15.obj");
-    auto2.SetShaderTextureNamePrefix("material.");
-    Model auto3("resources/objects/Auti/porsche_911_rwb/porche.obj");
-    auto3.SetShaderTextureNamePrefix("material.");
-    Model auto4("resources/objects/Auti/nissan_240sx_crveni/240sx.obj");
-    auto4.SetShaderTextureNamePrefix("material.");
-
-    Model drva("resources/objects/Priroda/custom drva/drvece.obj");
-    drva.SetShaderTextureNamePrefix("material.");
-
-    Model powerline("resources/objects/okoloputnici/powerline/scene.gltf");
-    powerline.SetShaderTextureNamePrefix("material.");
-
-    Model lamp("resources/objects/okoloputnici/street_lamp/scene.gltf");
-    lamp.SetShaderTextureNamePrefix("material.");
-
-    Model trava("resources/objects/Priroda/trava/textures/trava.obj");
-    trava.SetShaderTextureNamePrefix("material.");
-
-    Model zgrada("resources/objects/okoloputnici/zgrade/scene.gltf");
-    zgrada.SetShaderTextureNamePrefix("material.");
-
-    Model planina("resources/objects/Priroda/planine/scene.gltf");
-    planina.SetShaderTextureNamePrefix("material.");
-
-    Model terrain("resources/objects/Priroda/brda/scene.gltf");
-    terrain.SetShaderTextureNamePrefix("material.");
+    // parsing runs on worker threads and only the mesh upload happens here, the material textures start as
+    // placeholders and are streamed in over the first frames. all models share one texture cache
+    TextureStreamer textureStreamer;
+    TextureCache textureCache(&textureStreamer);
+    double loadStart = elapsedSeconds();
+    // models, instances, lights, fog and bloom come from the scene file, which is reloaded when it changes
+    SceneDescription sceneDescription;
+    if (!SceneDescription::Load(benchmark.scenePath, sceneDescription))
+        return -1;
+    if (benchmark.instanceScale > 0.0f)
+        sceneDescription.instanceScale = benchmark.instanceScale;
+    FileWatcher sceneWatcher(benchmark.scenePath);
+    speed = sceneDescription.speed;
+
+    // meshes are stored as compactly as the attributes the lighting shader reads allow
+    sceneShaders.shared = sceneShaderFeatures(sceneDescription);
+    deferredShaders.shared = sceneShaders.shared;
+    Mesh::StaticGeometry().format = VertexFormat::ForShader(sceneShaders.Get(ShaderVariants::MATERIAL_FEATURES));
+    std::cout << "Vertex format: " << Mesh::StaticGeometry().format.Name() << std::endl;
+
+    // every model stays loaded once it is, a reload only adds the ones that weren't there before
+    std::deque<Model> models;
+    vector<string> modelPaths;
+    vector<Model *> sceneModels;
+    loadSceneModels(sceneDescription, textureCache, models, modelPaths, sceneModels);
+    std::cout << "Loaded " << models.size() << " models in " << (elapsedSeconds() - loadStart) * 1000.0 << " ms" << std::endl;
+    std::cout << "Texture cache: " << textureCache.misses << " loaded, " << textureCache.hits << " shared" << std::endl;
+    std::cout << "Static geometry: " << Mesh::StaticGeometry().Meshes() << " meshes, "
+              << Mesh::StaticGeometry().VertexBytes() / (1024.0 * 1024.0) << " MB vertices ("
+              << Mesh::StaticGeometry().unpackedBytes / (1024.0 * 1024.0) << " MB unpacked), "
+              << Mesh::StaticGeometry().IndexBytes() / (1024.0 * 1024.0) << " MB indices" << std::endl;
+
+    // props that scroll past the cars
+    ScrollingLayers layers;
+    buildLayers(sceneDescription, sceneModels, layers);
+
+    // the variants the loaded materials need are compiled now rather than in the first frame
+    for (Model *sceneModel : sceneModels) {
+        for (const Mesh &mesh : sceneModel->meshes) {
+            sceneShaders.Get(mesh.features);
+            gBufferShaders.Get(mesh.features);
+        }
+    }
+    deferredShaders.Get(0);
+    std::cout << "Shader variants: " << sceneShaders.Count() << " lighting, " << gBufferShaders.Count() << " G-buffer, "
+              << deferredShaders.Count() << " deferred lighting" << std::endl;
+    const ProgramBinaryCache::Stats &programStats = ProgramBinaryCache::Statistics();
+    std::cout << "Shaders: " << programStats.loaded << " from program binaries, " << programStats.compiled
+              << " compiled, " << programStats.rejected << " binaries rejected, " << programStats.seconds * 1000.0
+              << " ms" << (ProgramBinaryCache::Enabled() ? "" : " (program binaries not supported)") << std::endl;
 
 
     //===============
 
 
-    //directional light
-    DirLight dirLight;
-    dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
-    dirLight.ambient = glm::vec3(0.5f);
-    dirLight.diffuse = glm::vec3(0.4f);
-    dirLight.specular = glm::vec3(0.5f);
-
     // Spotlight za farova auta
     SpotLight& spotLight = programState->spotLight;
+    spotLight.direction = glm::vec3(-1.0f, -0.01f, 0.0f);
     spotLight.ambient = glm::vec3(1.0, 1.0, 1.0);
     spotLight.diffuse = glm::vec3(0.3, 0.3, 0.9);
     spotLight.specular = glm::vec3(1.0, 1.0, 1.0);
@@ -355,6 +445,7 @@ int main() {
     spotLight.outerCutOff = glm::cos(glm::radians(10.0f));
 
     SpotLight& spotLight1 = programState->spotLight1;
+    spotLight1.direction = glm::vec3(-1.0f, -0.01f, 0.0f);
     spotLight1.ambient = glm::vec3(1.0, 1.0, 1.0);
     spotLight1.diffuse = glm::vec3(0.3, 0.3, 0.9);
     spotLight1.specular = glm::vec3(1.0, 1.0, 1.0);
@@ -365,13 +456,6 @@ int main() {
     spotLight1.outerCutOff = glm::cos(glm::radians(10.0f));
 
 
-    //fog
-    float fogDensity = 5.0f;
-    float fogStart = 30.0f;
-    float fogEnd = 100.0f;
-    glm::vec3 fogColor = glm::vec3(0.7f, 0.7f, 0.7f);
-
-
     //hdr-------------
     unsigned int hdrFBO;
     glGenFramebuffers(1, &hdrFBO);
@@ -397,7 +481,13 @@ int main() {
     glDrawBuffers(2, attachments);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+
+    // G-buffer for the deferred path, lit into hdrFBO like the forward path draws into it
+    GBuffer deferredTargets(SCR_WIDTH, SCR_HEIGHT);
+    gBuffer = &deferredTargets;
+    std::cout << "G-buffer: " << deferredTargets.Bytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
 
     // ping-pong-framebuffer for blurring
     unsigned int pingpongFBO[2];
@@ -445,80 +535,125 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
 
+    // skybox textures, every set is decoded and uploaded once here
+    stbi_set_flip_vertically_on_load(false);
+    SkyboxCache skyboxes;
+    unsigned int skybox1 = skyboxes.Load("skybox1");
+    unsigned int skybox2 = skyboxes.Load("skybox2");
+    // the third set is kept resident with the others, Q still switches between the first two
+    skyboxes.Load("skybox3");
+    const unsigned int activeSkybox[2] = { skybox2, skybox1 };
+    const unsigned int skyboxStartupAllocations = skyboxes.textureAllocations;
+
     // shader configuration
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
 
-    bool prekidac = false;
-    bool prekidac2 = true;
-    bool prekidac3 = true;
-    bool prekidac4 = false;
+    UniformHandle skyboxViewUniform = skyboxShader.uniform("view");
+    UniformHandle skyboxProjectionUniform = skyboxShader.uniform("projection");
+    UniformHandle blurHorizontalUniform = blurShader.uniform("horizontal");
+    UniformHandle bloomUniform = bloomShader.uniform("bloom");
+    UniformHandle exposureUniform = bloomShader.uniform("exposure");
+
+    // per-instance model matrices of the prop group that is being queued, one list per level of detail, reused every frame
+    std::vector<std::vector<glm::mat4>> instances;
+    // scene draws are queued and issued sorted by program, textures and VAO, redundant binds are dropped
+    RenderQueue renderQueue;
+    GLStateTracker glState;
+
+    Profiler profiler;
+    profiler.keepFrameTimes = benchmark.enabled;
+    vector<string> blurScopeNames;
+
+    // the simulation runs at a fixed rate, frames draw a blend of its last two states
+    FixedTimestep timestep;
+    SceneState previousScene, currentScene, scene;
+    resetScene(sceneDescription, layers, currentScene);
+    previousScene = scene = currentScene;
+
+    // measured frames start with every texture in place
+    while (benchmark.enabled && textureStreamer.pending > 0) {
+        textureStreamer.Update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window)) {
+    while (benchmark.enabled ? benchmark.Running() : !glfwWindowShouldClose(window)) {
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
+        float currentFrame = benchmark.enabled ? benchmark.Time() : glfwGetTime();
+        deltaTime = benchmark.enabled ? benchmark.deltaTime : currentFrame - lastFrame;
         lastFrame = currentFrame;
+        if (benchmark.enabled)
+            benchmark.BeginFrame();
+        profiler.BeginFrame();
 
         // input
         // -----
-        processInput(window);
+        if (benchmark.enabled)
+            benchmark.PlaceCamera(programState->camera);
+        else
+            processInput(window);
+
+        // bounded slice of texture uploads, the rest waits for the next frame
+        if (textureStreamer.pending > 0)
+        {
+            profiler.Begin("Texture streaming");
+            textureStreamer.Update();
+            profiler.End();
+            if (textureStreamer.pending == 0)
+            {
+                std::cout << "Textures streamed in " << (elapsedSeconds() - loadStart) * 1000.0 << " ms" << std::endl;
+                // shared textures count towards every model that uses them, the total counts them once
+                std::cout << "Texture memory per model:" << std::endl;
+                for (unsigned int i = 0; i < models.size(); i++)
+                    std::cout << "  " << modelPaths[i] << ": " << models[i].TextureMemory() / (1024.0 * 1024.0) << " MB" << std::endl;
+                std::cout << "  total: " << textureCache.TextureMemory() / (1024.0 * 1024.0) << " MB" << std::endl;
+            }
+        }
+
+        // scene file
+        // ----------
+        if (!benchmark.enabled && sceneWatcher.Changed(deltaTime)
+            && SceneDescription::Load(benchmark.scenePath, sceneDescription)) {
+            loadSceneModels(sceneDescription, textureCache, models, modelPaths, sceneModels);
+            buildLayers(sceneDescription, sceneModels, layers);
+            speed = sceneDescription.speed;
+            // the animation starts over, car and layer counts may have changed
+            resetScene(sceneDescription, layers, currentScene);
+            previousScene = scene = currentScene;
+            std::cout << "Scene reloaded: " << benchmark.scenePath << std::endl;
+        }
+
+        // simulation
+        // ----------
+        profiler.Begin("Simulation");
+        unsigned int steps = timestep.Advance(deltaTime);
+        for (unsigned int i = 0; i < steps; i++) {
+            previousScene = currentScene;
+            updateScene(currentScene, sceneDescription, layers, timestep.step, programState->move);
+        }
+        interpolateScene(previousScene, currentScene, layers, timestep.Alpha(), scene);
+        profiler.End();
 
         //donja granica za kameru
         if (programState->camera.Position.y < 1.5f)
             programState->camera.Position.y = 1.5f;
 
-        // skybox textures
-        stbi_set_flip_vertically_on_load(false);
-        vector<std::string> faces;
-        if(programState->skySwitch) {
-            faces = {
-                    FileSystem::getPath("resources/textures/skybox1/right.png"),
-                    FileSystem::getPath("resources/textures/skybox1/left.png"),
-                    FileSystem::getPath("resources/textures/skybox1/top.png"),
-                    FileSystem::getPath("resources/textures/skybox1/bottom.png"),
-                    FileSystem::getPath("resources/textures/skybox1/front.png"),
-                    FileSystem::getPath("resources/textures/skybox1/back.png")
-            };
-        }
-        else {
-            faces = {
-                    FileSystem::getPath("resources/textures/skybox2/right.png"),
-                    FileSystem::getPath("resources/textures/skybox2/left.png"),
-                    FileSystem::getPath("resources/textures/skybox2/top.png"),
-                    FileSystem::getPath("resources/textures/skybox2/bottom.png"),
-                    FileSystem::getPath("resources/textures/skybox2/front.png"),
-                    FileSystem::getPath("resources/textures/skybox2/back.png")
-            };
-        }
-        unsigned int cubemapTexture = loadCubemap(faces);
+        // skybox textures are resident since startup, Q only picks which one is bound
+        unsigned int cubemapTexture = activeSkybox[programState->skySwitch];
 
         // render
         // ------
+        profiler.Begin("Scene");
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-
-        //fog
-        ourShader.setFloat("fogDensity", fogDensity);
-        ourShader.setFloat("fogStart", fogStart);
-        ourShader.setFloat("fogEnd", fogEnd);
-        ourShader.setVec3("fogColor", fogColor);
-        ourShader.setFloat("transparent", 1.0f);
-
-
         //dir light
-        ourShader.setVec3("dirLight.direction", dirLight.direction);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-        ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        ourShader.setVec3("dirLight.specular", dirLight.specular);
+        lightBuffer.SetDirLight(sceneDescription.dirLight);
 
         //funkcionalnost dugih svetala
         if(programState->blicaj){
@@ -562,228 +697,37 @@ int main() {
         }
 
 
-        // Spotlight
-        ourShader.setVec3("spotLight.direction", -1.0f, -0.01f, 0.0f);
-        ourShader.setVec3("spotLight.ambient", spotLight.ambient);
-        ourShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        ourShader.setVec3("spotLight.specular", spotLight.specular);
-        ourShader.setFloat("spotLight.constant", spotLight.constant);
-        ourShader.setFloat("spotLight.linear", spotLight.linear);
-        ourShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        ourShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        ourShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-
-        ourShader.setVec3("spotLight1.direction", -1.0f, -0.01f, 0.0f);
-        ourShader.setVec3("spotLight1.ambient", spotLight1.ambient);
-        ourShader.setVec3("spotLight1.diffuse", spotLight1.diffuse);
-        ourShader.setVec3("spotLight1.specular", spotLight1.specular);
-        ourShader.setFloat("spotLight1.constant", spotLight1.constant);
-        ourShader.setFloat("spotLight1.linear", spotLight1.linear);
-        ourShader.setFloat("spotLight1.quadratic", spotLight1.quadratic);
-        ourShader.setFloat("spotLight1.cutOff", spotLight1.cutOff);
-        ourShader.setFloat("spotLight1.outerCutOff", spotLight1.outerCutOff);
-
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 10.0f);
         // view/projection transformations
+        const float nearPlane = 0.1f, farPlane = 100.0f + 69.0f;
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f + 69.0f);
+                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, nearPlane, farPlane);
         glm::mat4 view = programState->camera.GetViewMatrix();
         glm::mat4 model = glm::mat4(1.0f);
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-
-        //pomeranje auta
-        if(programState->move) {
-
-            float napred = 5.0f;
-            float nazad = 3.0f;
-
-
-            //1
-            if (prekidac)
-                programState->nisanPosition1.x -= napred * deltaTime;
-            if(!prekidac)
-                programState->nisanPosition1.x += nazad * deltaTime;
-            if (programState->nisanPosition1.x <= 6.0f)
-                prekidac = false;
-            if (programState->nisanPosition1.x >= 17.0f)
-                prekidac = true;
-
-
-            //2
-            if (prekidac2)
-                programState->nisanPosition2.x -= napred * deltaTime;
-            if(!prekidac2)
-                programState->nisanPosition2.x += nazad * deltaTime;
-            if (programState->nisanPosition2.x <= -5.0f) {
-                prekidac2 = false;
-            }
-            if (programState->nisanPosition2.x >= 5.0f)
-                prekidac2 = true;
-
-
-            programState->nisanPosition4.z = sin(currentFrame * 1.2f) / 2;
-
-            //3
-            if (prekidac3)
-                programState->nisanPosition3.x -= napred * deltaTime;
-            if(!prekidac3)
-                programState->nisanPosition3.x += nazad * deltaTime;
-            if (programState->nisanPosition3.x <= -17.0f) {
-                prekidac3 = false;
-            }
-            if (programState->nisanPosition3.x >= -6.0f)
-                prekidac3 = true;
+        // everything the camera can't see is skipped before it reaches GL
+        Frustum frustum(projection * view);
+        CullStats cullStats;
+        // distant objects are drawn at coarser levels, the ones past the end of the fog not at all
+        LodSelector lods(programState->camera.Position, programState->camera.Zoom, (float) framebufferHeight,
+                         sceneDrawDistance(sceneDescription));
 
 
-            //4
-            if (prekidac4)
-                programState->nisanPosition4 .x -= napred * deltaTime;
-            if(!prekidac4)
-                programState->nisanPosition4 .x += nazad * deltaTime;
-            if (programState->nisanPosition4.x <= -33.0f) {
-                prekidac4 = false;
-            }
-            if (programState->nisanPosition4.x >= -18.0f)
-                prekidac4 = true;
-
-
-
-        }
-        ourShader.setVec3("spotLight.position", programState->nisanPosition3 + glm::vec3(-0.9,0.06,0.48));
-        ourShader.setVec3("spotLight1.position", programState->nisanPosition3 + glm::vec3(-0.9,0.06,-0.48));
-
-
-
-        // renderovanje puta
-        if(programState->move)
-            programState->putPosition.x += speed * deltaTime;
-
-        //funkcionalnost puta
-        if (programState->putPosition.x >= -49.0f)
-            programState->putPosition.x = -80.0f;
-
-        model = glm::mat4(1.0f);
-        for (int i = 0; i < 6; ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, programState->putPosition + glm::vec3(31.0f * float(i), 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(programState->putScale));
-            ourShader.setMat4("model", model);
-            put.Draw(ourShader);
-        }
-
-
-        //1. auto
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,programState->nisanPosition1);
-        model = glm::scale(model, glm::vec3(programState->nisanScale1));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        auto1.Draw(ourShader);
-
-        //2. auto
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,programState->nisanPosition2);
-        model = glm::scale(model, glm::vec3(programState->nisanScale2));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        auto2.Draw(ourShader);
-
-        //3. auto
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,programState->nisanPosition3);
-        model = glm::scale(model, glm::vec3(programState->nisanScale3));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        auto3.Draw(ourShader);
-
-        //4. auto
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,programState->nisanPosition4);
-        model = glm::scale(model, glm::vec3(programState->nisanScale4));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        auto4.Draw(ourShader);
-
-
-        //renderovanje drveca
-        if(programState->move)
-            programState->drvoPosition.x += speed * deltaTime;
-        if (programState->drvoPosition.x >= -40.0f)
-            programState->drvoPosition.x = -80.0f;
-
-        model = glm::mat4(1.0f);
-        for (int i = 0; i < 5; ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,programState->drvoPosition + glm::vec3(40.0f * float(i), 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(programState->drvoScale));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            ourShader.setMat4("model", model);
-            drva.Draw(ourShader);
-        }
-
-
-
-        //render zgrada
-        if(programState->move)
-            programState->zgradePosition.x += speedZgrada * deltaTime;
-        if (programState->zgradePosition.x >= -70.0f)
-            programState->zgradePosition.x = -140.0f;
-
-        model = glm::mat4(1.0f);
-        for (int i = 0; i < 4; ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,programState->zgradePosition + glm::vec3(70.0f * float(i), 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(programState->zgradeScale));
-            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            ourShader.setMat4("model", model);
-            zgrada.Draw(ourShader);
-        }
-
-        //render stubova
-        if(programState->move)
-            programState->pwrlPosition.x += speed * deltaTime;
-        if (programState->pwrlPosition.x >= -48.6f)
-            programState->pwrlPosition.x = -64.8f;
-
-        model = glm::mat4(1.0f);
-        for (int i = 0; i < 10; ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,programState->pwrlPosition + glm::vec3(16.2f * float(i), 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(programState->pwrlScale));
-            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            ourShader.setMat4("model", model);
-            powerline.Draw(ourShader);
-        }
-
-
-        //render lampi
-        if(programState->move)
-            programState->lampPosition.x += speed * deltaTime;
-        if (programState->lampPosition.x >= -60.0f)
-            programState->lampPosition.x = -90.0f;
-
-        model = glm::mat4(1.0f);
-        for (int i = 0; i < 7; ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,programState->lampPosition + glm::vec3(30.0f * float(i), 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(programState->lampScale));
-            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            ourShader.setMat4("model", model);
-            lamp.Draw(ourShader);
+        // Spotlight
+        if (sceneDescription.headlightCar >= 0) {
+            glm::vec3 offset = sceneDescription.headlightOffset;
+            spotLight.position = scene.cars[sceneDescription.headlightCar] + offset;
+            spotLight1.position = scene.cars[sceneDescription.headlightCar] + glm::vec3(offset.x, offset.y, -offset.z);
         }
-
-
-        //spotlight za lampu
-        std::vector<SpotLight> spotLights;
-        for (int i = 0; i < 7; ++i) {
+        lightBuffer.SetSpotLight(0, spotLight);
+        lightBuffer.SetSpotLight(1, spotLight1);
+
+        // a spot light for every copy of the lamp layer
+        profiler.Begin("Light clusters");
+        lightClusters.Clear();
+        unsigned int lampCount = sceneDescription.lampLayer >= 0 ? layers.Count(sceneDescription.lampLayer) : 0;
+        for (unsigned int i = 0; i < lampCount; ++i) {
             SpotLight LampLight;
-            LampLight.position = programState->lampPosition + glm::vec3(30.0f * float(i), 6.8f, -3.4f);
+            LampLight.position = glm::vec3(0.0f);
+            LampLight.direction = glm::vec3(0.0f, -1.0f, 0.0f);
             LampLight.ambient = glm::vec3(1.0, 1.0, 1.0);
             LampLight.diffuse = glm::vec3(1.0, 0.7, 0.0);
             LampLight.specular = glm::vec3(1.0, 0.7, 0.0);
@@ -792,98 +736,95 @@ int main() {
             LampLight.quadratic = 0.032f;
             LampLight.cutOff = glm::cos(glm::radians(10.0f));
             LampLight.outerCutOff = glm::cos(glm::radians(25.0f));
-            spotLights.push_back(LampLight);
+            LampLight.position = layers.Position(sceneDescription.lampLayer, i, scene.scroll.data()) + sceneDescription.lampLightOffset;
+            lightClusters.Add(LampLight);
         }
-
-        for (size_t i = 0; i < spotLights.size(); ++i) {
-            ourShader.setVec3("spotLights[" + std::to_string(i) + "].direction", 0.0f, -1.0f, 0.0f);
-            ourShader.setVec3("spotLights[" + std::to_string(i) + "].ambient", spotLights[i].ambient);
-            ourShader.setVec3("spotLights[" + std::to_string(i) + "].diffuse", spotLights[i].diffuse);
-            ourShader.setVec3("spotLights[" + std::to_string(i) + "].specular", spotLights[i].specular);
-            ourShader.setFloat("spotLights[" + std::to_string(i) + "].constant", spotLights[i].constant);
-            ourShader.setFloat("spotLights[" + std::to_string(i) + "].linear", spotLights[i].linear);
-            ourShader.setFloat("spotLights[" + std::to_string(i) + "].quadratic", spotLights[i].quadratic);
-            ourShader.setFloat("spotLights[" + std::to_string(i) + "].cutOff", spotLights[i].cutOff);
-            ourShader.setFloat("spotLights[" + std::to_string(i) + "].outerCutOff", spotLights[i].outerCutOff);
-            ourShader.setVec3("spotLights[" + std::to_string(i) + "].position", spotLights[i].position);
+        lightClusters.Build(view, programState->camera.Zoom, (float) framebufferWidth, (float) framebufferHeight, nearPlane, farPlane);
+        profiler.End();
+
+        // in deferred mode the geometry only fills the G-buffer, the lights are evaluated once per pixel
+        ShaderVariants &sceneShader = programState->deferred ? gBufferShaders : sceneShaders;
+        // fog and headlights hold for the whole scene, the material picks the rest of the variant
+        sceneShaders.shared = sceneShaderFeatures(sceneDescription);
+        deferredShaders.shared = sceneShaders.shared;
+
+        // one buffer update for everything that changed since the last frame
+        lightBuffer.Upload();
+
+        // auti
+        for (unsigned int i = 0; i < sceneDescription.cars.size(); ++i) {
+            const SceneCar &car = sceneDescription.cars[i];
+            model = glm::translate(glm::mat4(1.0f), scene.cars[i]) * car.transform;
+            sceneModels[car.model]->Submit(renderQueue, sceneShader, model, frustum, lods, cullStats);
         }
 
-        //render trave------------------------------------------
+        // put, drvece, zgrade, stubovi, lampe, trava i brda
+        layers.Submit(renderQueue, sceneShader, scene.scroll.data(), frustum, lods, cullStats, instances);
 
-        //pomeranje trave
-        if(programState->move) {
-            programState->travaPosition.x += speed * deltaTime;
-            programState->trava2Position.x += speed * deltaTime;
-        }
-        if (programState->travaPosition.x >= -40.0f)
-            programState->travaPosition.x = -100.0f;
-        if (programState->trava2Position.x >= -40.0f)
-            programState->trava2Position.x = -100.0f;
-
-        glDisable(GL_CULL_FACE);
-        model = glm::mat4(1.0f);
-        //desno
-        for (int i = 0; i < 3; ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,programState->travaPosition + glm::vec3(60.0f * float(i), 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(programState->travaScale));
-            ourShader.setMat4("model", model);
-            trava.Draw(ourShader);
-        }
-        //levo
-        model = glm::mat4(1.0f);
-        for (int i = 0; i < 3; ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,programState->trava2Position + glm::vec3(60.0f * float(i), 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(programState->travaScale));
-            ourShader.setMat4("model", model);
-            trava.Draw(ourShader);
+        // planine i ostalo sto stoji u mestu
+        for (const SceneObject &object : sceneDescription.objects) {
+            model = glm::translate(glm::mat4(1.0f), object.position) * object.transform;
+            sceneModels[object.model]->Submit(renderQueue, sceneShader, model, frustum, lods, cullStats, object.doubleSided);
         }
 
-        //render planine-----------------------------------
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,programState->planinaPosition);
-        model = glm::scale(model, glm::vec3(programState->planinaScale));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(5.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        planina.Draw(ourShader);
-
-        //render brda
-        if(programState->move) {
-            programState->terrainPosition.x += speed * deltaTime;
-            programState->terrain1Position.x += speed * deltaTime;
+        // per-frame uniforms go to every variant, after the submits so the ones compiled this frame get them too
+        sceneShader.ForEach([&](Shader &shader) {
+            const LightingUniforms &uniforms = lightingUniforms[shader.ID];
+            shader.use();
+            shader.setMat4(uniforms.projection, projection);
+            shader.setMat4(uniforms.view, view);
+            if (programState->deferred)
+                return;
+            shader.setFloat(uniforms.fogDensity, sceneDescription.fogDensity);
+            shader.setFloat(uniforms.fogStart, sceneDescription.fogStart);
+            shader.setFloat(uniforms.fogEnd, sceneDescription.fogEnd);
+            shader.setVec3(uniforms.fogColor, sceneDescription.fogColor);
+            shader.setVec3(uniforms.viewPosition, programState->camera.Position);
+            lightClusters.Apply(shader);
+        });
+
+        glState.ResetCounts();
+        if (!programState->deferred) {
+            renderQueue.Flush(glState);
+        } else {
+            profiler.Begin("G-buffer");
+            deferredTargets.BeginGeometry();
+            renderQueue.Flush(glState);
+            deferredTargets.EndGeometry();
+            profiler.End();
+
+            // a full-screen pass into hdrFBO, like the forward draws; it writes the G-buffer depth back so the skybox
+            // afterwards only passes the depth test where nothing was drawn
+            profiler.Begin("Deferred lighting");
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+            Shader &deferredShader = deferredShaders.Get(0);
+            const LightingUniforms &uniforms = lightingUniforms[deferredShader.ID];
+            deferredShader.use();
+            deferredShader.setMat4(uniforms.view, view);
+            deferredShader.setMat4(uniforms.inverseViewProjection, glm::inverse(projection * view));
+            deferredShader.setFloat(uniforms.fogStart, sceneDescription.fogStart);
+            deferredShader.setFloat(uniforms.fogEnd, sceneDescription.fogEnd);
+            deferredShader.setVec3(uniforms.fogColor, sceneDescription.fogColor);
+            deferredShader.setVec3(uniforms.viewPosition, programState->camera.Position);
+            lightClusters.Apply(deferredShader);
+            deferredTargets.BindTextures();
+            glDepthFunc(GL_ALWAYS);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS);
+            profiler.End();
         }
-        if (programState->terrainPosition.x >= 214.0f)
-            programState->terrainPosition.x = -214.0f;
-        if (programState->terrain1Position.x >= 214.0f)
-            programState->terrain1Position.x = -214.0f;
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,programState->terrainPosition);
-        model = glm::scale(model, glm::vec3(programState->terrainScale));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        terrain.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,programState->terrain1Position);
-        model = glm::scale(model, glm::vec3(programState->terrainScale));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        terrain.Draw(ourShader);
-
-
-        glEnable(GL_CULL_FACE);
+        profiler.End();
 
 
         // draw skybox
+        profiler.Begin("Skybox");
         glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
         view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
+        skyboxShader.setMat4(skyboxViewUniform, view);
+        skyboxShader.setMat4(skyboxProjectionUniform, projection);
         // skybox cube
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
@@ -891,15 +832,20 @@ int main() {
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS); // set depth function back to default
+        profiler.End();
 
         //HDR
+        profiler.Begin("Bloom blur");
         bool horizontal = true, first_iteration = true;
-        unsigned int amount = 5;
+        unsigned int amount = sceneDescription.bloomPasses;
+        while (blurScopeNames.size() < amount)
+            blurScopeNames.push_back("Blur " + std::to_string(blurScopeNames.size()));
         blurShader.use();
         for (unsigned int i = 0; i < amount; i++)
         {
+            profiler.Begin(blurScopeNames[i]);
             glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
+            blurShader.setInt(blurHorizontalUniform, horizontal);
             glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
             glBindVertexArray(quadVAO);
             glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -907,11 +853,14 @@ int main() {
             horizontal = !horizontal;
             if (first_iteration)
                 first_iteration = false;
+            profiler.End();
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+        profiler.End();
 
         // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
         // --------------------------------------------------------------------------------------------------------------------------
+        profiler.Begin("Bloom composite");
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         bloomShader.use();
         glActiveTexture(GL_TEXTURE0);
@@ -919,16 +868,25 @@ int main() {
         glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        bloomShader.setInt("bloom", programState->hdrSwitch);
-        bloomShader.setFloat("exposure", 0.5f);
+        bloomShader.setInt(bloomUniform, programState->hdrSwitch);
+        bloomShader.setFloat(exposureUniform, sceneDescription.exposure);
         glBindVertexArray(quadVAO);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
         glBindVertexArray(0);
+        profiler.End();
 
 
 
 
-        DrawImGui(programState);
+        profiler.Begin("ImGui");
+        DrawImGui(programState, textureCache, profiler, cullStats, glState, lightClusters);
+        profiler.End();
+        profiler.EndFrame();
+
+        if (benchmark.enabled) {
+            benchmark.EndFrame();
+            continue;
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -936,24 +894,161 @@ int main() {
         glfwPollEvents();
     }
 
-    programState->SaveToFile("resources/program_state.txt");
+    if (benchmark.enabled)
+        benchmark.Finish(profiler);
+    else
+        programState->SaveToFile("resources/program_state.txt");
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (window)
+        ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    std::cout << "Skybox textures allocated after startup: "
+              << skyboxes.textureAllocations - skyboxStartupAllocations << std::endl;
+
     // deallocate
+    skyboxes.Release();
+    lightBuffer.Release();
+    lightClusters.Release();
+    gBuffer = nullptr;
+    deferredTargets.Release();
+    sceneShaders.Release();
+    gBufferShaders.Release();
+    deferredShaders.Release();
+    renderQueue.Release();
+    Mesh::StaticGeometry().Release();
+    for (Model &loaded : models)
+        loaded.ReleaseTextures();
+    textureStreamer.Release();
+    profiler.Release();
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &skyboxVBO);
     glDeleteBuffers(1, &quadVBO);
 
+    if (benchmark.enabled) {
+        headlessContext.Release();
+        return 0;
+    }
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
     return 0;
 }
 
+// loads the models of the scene that aren't loaded yet, all of them in one batch, and maps every model of the
+// scene to its loaded Model
+// ------------------------------------------------------------------------------------------------------------
+void loadSceneModels(const SceneDescription &description, TextureCache &textureCache, std::deque<Model> &models,
+                     vector<string> &modelPaths, vector<Model *> &sceneModels) {
+    vector<string> missing;
+    for (const string &path : description.modelPaths)
+        if (std::find(modelPaths.begin(), modelPaths.end(), path) == modelPaths.end()
+            && std::find(missing.begin(), missing.end(), path) == missing.end())
+            missing.push_back(path);
+
+    if (!missing.empty()) {
+        vector<Model> loaded = ModelLoader::LoadAll(missing, &textureCache);
+        for (unsigned int i = 0; i < loaded.size(); ++i) {
+            models.push_back(std::move(loaded[i]));
+            models.back().SetShaderTextureNamePrefix("material.");
+            modelPaths.push_back(missing[i]);
+            const VertexCacheStats &stats = models.back().cacheStats;
+            std::cout << "Vertex cache " << missing[i] << ": ACMR " << stats.ACMR(stats.missesBefore) << " -> "
+                      << stats.ACMR(stats.missesAfter) << ", ATVR " << stats.ATVR(stats.missesBefore) << " -> "
+                      << stats.ATVR(stats.missesAfter) << std::endl;
+            std::cout << "Levels of detail " << missing[i] << ":";
+            for (unsigned int level = 0; level <= models.back().lodErrors.size(); ++level) {
+                unsigned int triangles = 0;
+                for (const Mesh &mesh : models.back().meshes)
+                    triangles += mesh.Lod(level).indexCount / 3;
+                std::cout << (level > 0 ? " ->" : "") << " " << triangles;
+            }
+            std::cout << " triangles" << std::endl;
+        }
+    }
+
+    sceneModels.clear();
+    for (const string &path : description.modelPaths)
+        sceneModels.push_back(&models[std::find(modelPaths.begin(), modelPaths.end(), path) - modelPaths.begin()]);
+}
+
+void buildLayers(const SceneDescription &description, const vector<Model *> &sceneModels, ScrollingLayers &layers) {
+    layers.Clear();
+    for (unsigned int i = 0; i < description.layers.size(); ++i) {
+        ScrollingLayer layer = description.layers[i].layer;
+        layer.model = sceneModels[description.layers[i].model];
+        layer.count = description.LayerCount(i);
+        layers.Add(layer);
+    }
+}
+
+// features of the lighting shader that depend on the scene rather than on a material
+unsigned int sceneShaderFeatures(const SceneDescription &description) {
+    unsigned int features = ShaderVariants::SpotLights(description.headlightCar >= 0 ? 2 : 0);
+    if (description.fogEnd > description.fogStart)
+        features |= ShaderVariants::FOG;
+    return features;
+}
+
+// past the end of the fog nothing is visible anymore; a scene without fog draws everything
+float sceneDrawDistance(const SceneDescription &description) {
+    if (description.fogEnd > description.fogStart)
+        return description.fogEnd;
+    return std::numeric_limits<float>::max();
+}
+
+// puts everything where the scene file says it starts
+void resetScene(const SceneDescription &description, const ScrollingLayers &layers, SceneState &state) {
+    state.time = 0.0f;
+    state.cars.clear();
+    state.carsForward.clear();
+    for (const SceneCar &car : description.cars) {
+        state.cars.push_back(car.position);
+        state.carsForward.push_back(car.forward);
+    }
+    state.scroll.assign(layers.Size(), 0.0f);
+}
+
+// one fixed step of the animation, the only place that moves anything in the scene
+// ------------------------------------------------------------------------------------
+void updateScene(SceneState &state, const SceneDescription &description, const ScrollingLayers &layers,
+                 float deltaTime, bool move) {
+    state.time += deltaTime;
+    if (!move)
+        return;
+
+    //pomeranje auta
+    for (unsigned int i = 0; i < description.cars.size(); ++i) {
+        const SceneCar &car = description.cars[i];
+        glm::vec3 &position = state.cars[i];
+        if (state.carsForward[i])
+            position.x -= description.carForward * deltaTime;
+        else
+            position.x += description.carBackward * deltaTime;
+        if (position.x <= car.minX)
+            state.carsForward[i] = false;
+        if (position.x >= car.maxX)
+            state.carsForward[i] = true;
+        if (car.swayAmplitude != 0.0f)
+            position.z = car.swayAmplitude * sin(state.time * car.swayFrequency);
+    }
+
+    // put, drvece, zgrade, stubovi, lampe, trava i brda
+    layers.Advance(state.scroll.data(), speed * deltaTime);
+}
+
+void interpolateScene(const SceneState &previous, const SceneState &current, const ScrollingLayers &layers,
+                      float alpha, SceneState &scene) {
+    scene.time = glm::mix(previous.time, current.time, alpha);
+    scene.carsForward = current.carsForward;
+    for (unsigned int i = 0; i < current.cars.size(); ++i)
+        scene.cars[i] = glm::mix(previous.cars[i], current.cars[i], alpha);
+    layers.Blend(previous.scroll.data(), current.scroll.data(), alpha, scene.scroll.data());
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
@@ -973,22 +1068,16 @@ void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
         programState->camera.ProcessKeyboard(DOWN, deltaTime);
 
-    //brzina trake
+    //brzina trake, zgrade idu srazmerno sporije
     if(glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
         speed += 0.5;
-        speedZgrada += 0.5;
         if(speed >= 197.0f)
             speed = 197.0f;
-        if(speedZgrada >= 194.5f)
-            speedZgrada = 194.5f;
     }
     if(glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
         speed -= 0.5;
-        speedZgrada -= 0.5;
         if(speed <= 2.0f)
             speed = 2.0f;
-        if(speedZgrada <= 2.5f)
-            speedZgrada = 2.5f;
 
     }
 }
@@ -1001,6 +1090,10 @@ void hdrResize(int width, int height) {
     }
     glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+    if (gBuffer)
+        gBuffer->Resize(width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void bloomResize(int width, int height) {
@@ -1045,9 +1138,15 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-void DrawImGui(ProgramState *programState) {
+void DrawImGui(ProgramState *programState, const TextureCache &textureCache, const Profiler &profiler,
+               const CullStats &cullStats, const GLStateTracker &glState, const LightClusters &lightClusters) {
     ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (headless) {
+        ImGuiIO &io = ImGui::GetIO();
+        io.DisplaySize = ImVec2((float) SCR_WIDTH, (float) SCR_HEIGHT);
+        io.DeltaTime = deltaTime;
+    } else
+        ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
     //fps info
@@ -1068,6 +1167,49 @@ void DrawImGui(ProgramState *programState) {
     ImGui::TextColored(textColor, "FPS: %.1f", fps);
     ImGui::End();
 
+    //texture cache and culling info
+    ImGui::SetNextWindowPos(ImVec2(5, 5));
+    ImGui::SetNextWindowSize(ImVec2(0, 0));
+    ImGui::Begin("Texture cache", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoBackground);
+    ImGui::Text("Textures: %zu (hits %u, misses %u)", textureCache.Size(), textureCache.hits, textureCache.misses);
+    ImGui::Text("Saved: %.1f MB of %.1f MB", textureCache.bytesSaved / (1024.0 * 1024.0),
+                (textureCache.bytesSaved + textureCache.bytesLoaded) / (1024.0 * 1024.0));
+    ImGui::Text("Meshes: %u drawn, %u culled, %u in fog", cullStats.drawn, cullStats.culled, cullStats.fogged);
+    ImGui::Text("LOD: %u / %u / %u / %u", cullStats.levels[0], cullStats.levels[1], cullStats.levels[2], cullStats.levels[3]);
+    ImGui::Text("State changes: %u issued, %u skipped", glState.Issued(), glState.Skipped());
+    ImGui::Text("Lamps: %u, %u cluster entries, at most %u per cluster", lightClusters.lightCount,
+                lightClusters.indexCount, lightClusters.maxPerCluster);
+    ImGui::Text("Shading: %s (G)", programState->deferred ? "deferred" : "forward");
+    ImGui::End();
+
+    //profiler
+    if (programState->ImGuiEnabled) {
+        ImGui::Begin("Profiler");
+        ImGui::Columns(3);
+        ImGui::Text("Scope");
+        ImGui::NextColumn();
+        ImGui::Text("CPU ms min/avg/max");
+        ImGui::NextColumn();
+        ImGui::Text("GPU ms min/avg/max");
+        ImGui::NextColumn();
+        ImGui::Separator();
+        for (unsigned int index : profiler.DisplayOrder()) {
+            const Profiler::Stat &stat = profiler.Stats()[index];
+            float minimum, average, maximum;
+            ImGui::Text("%*s%s", stat.depth * 2, "", stat.name.c_str());
+            ImGui::NextColumn();
+            stat.cpu.Summary(minimum, average, maximum);
+            ImGui::Text("%.2f / %.2f / %.2f", minimum, average, maximum);
+            ImGui::NextColumn();
+            stat.gpu.Summary(minimum, average, maximum);
+            ImGui::Text("%.2f / %.2f / %.2f", minimum, average, maximum);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::Text("GPU frames dropped: %u", profiler.droppedFrames);
+        ImGui::End();
+    }
+
     //camera info
 //    if (programState->ImGuiEnabled) {
 //        ImGui::Begin("Camera info");
@@ -1104,6 +1246,9 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     if(key == GLFW_KEY_Q && action == GLFW_PRESS) {
         programState->skySwitch = !programState->skySwitch;
     }
+    if(key == GLFW_KEY_G && action == GLFW_PRESS) {
+        programState->deferred = !programState->deferred;
+    }
     if(key == GLFW_KEY_H && action == GLFW_PRESS) {
         programState->hdrSwitch = !programState->hdrSwitch;
     }
@@ -1125,30 +1270,3 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         }
     }
 }
-
-//skybox
-unsigned int loadCubemap(vector<std::string> faces){
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++){
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data){
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else{
-            std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}